@@ -14,6 +14,7 @@
 #include "TGeometryConfig.h"
 #include "TDetector.h"
 #include "TGeneralConfig.h"
+#include "TSamuraiTracer.h"
 
 #include <TH2F.h>
 #include <TGraph.h>
@@ -156,7 +157,8 @@ void AddExitObjects(TObjArray *drawees, TObjArray*)
    drawees->Add(sixty_deg);
 }
 
-void AddDetectors(TObjArray *drawees, const TGeneralConfig *conf){
+void AddDetectors(TObjArray *drawees, const TGeneralConfig *conf,
+		  art::TSamuraiTracer *tracer){
    const TGeometryConfig* geoConf = TGeometryConfig::GetInstance();
    TDetector::SetOrigin(geoConf->GetExitWindowX(),geoConf->GetExitWindowY());
    TDetector::SetAngle(geoConf->GetExitAngle());
@@ -171,6 +173,11 @@ void AddDetectors(TObjArray *drawees, const TGeneralConfig *conf){
       if(!detector) continue;
       drawees->Add(detector);
       AddLegend(drawees,conf,detector->GetTitle());
+      Double_t x, y, width, angle;
+      if (tracer && detector->GetEffectiveArea(&x,&y,&width,&angle)) {
+	 tracer->AddRectangle(x,y,angle,width,0.,
+			      art::TSamuraiTracer::kRecord,detector->GetName());
+      }
    }
 }
 
@@ -13,6 +13,9 @@
 #define INCLUDE_GUARD_UUID_793E2F03_85E3_422D_9746_38B3A0991ED6
 
 class TObjArray;
+namespace art {
+   class TSamuraiTracer;
+}
 
 
 #include <Rtypes.h>
@@ -24,7 +27,9 @@ void AddAxes(double xmin, double ymin, double xmax, double ymax,
 	     TObjArray *drawees);
 void AddMagnet(TObjArray *drawees, TObjArray *bounds);
 void AddExitObjects(TObjArray *drawees, TObjArray *bounds);
-void AddDetectors(TObjArray *drawees, const TGeneralConfig *conf);
+// with a tracer, the crossings of the effective areas are recorded
+void AddDetectors(TObjArray *drawees, const TGeneralConfig *conf,
+		  art::TSamuraiTracer *tracer = NULL);
 void AddLegend(TObjArray *drawees, const TGeneralConfig *conf,
 	       const char* latex, Color_t color = 1);
 void ForwardLegend();
@@ -0,0 +1,71 @@
+/**
+ * @file   TCompositeField.cc
+ * @brief  superposition of magnetic fields
+ *
+ * @date   Created       : 2026-10-17 19:40:12 JST
+ *         Last Modified : 2026-10-17 19:40:12 JST (kawase)
+ * @author KAWASE Shoichiro <kawase@aees.kyushu-u.ac.jp>
+ *
+ *    (C) 2016 KAWASE Shoichiro
+ */
+
+#include "TCompositeField.h"
+
+#include <algorithm>
+
+using art::TCompositeField;
+
+TCompositeField::TCompositeField()
+   : fFields(), fWeights(), fScale(1.)
+{
+}
+
+TCompositeField::~TCompositeField()
+{
+   for (size_t i = 0; i != fFields.size(); ++i) {
+      delete fFields[i];
+   }
+}
+
+void TCompositeField::Add(TMagneticField *field, double weight)
+{
+   fFields.push_back(field);
+   fWeights.push_back(weight);
+}
+
+bool TCompositeField::IsGood() const
+{
+   if (fFields.empty()) return false;
+   for (size_t i = 0; i != fFields.size(); ++i) {
+      if (!fFields[i] || !fFields[i]->IsGood()) return false;
+   }
+   return true;
+}
+
+bool TCompositeField::GetBounds(double min[3], double max[3]) const
+{
+   if (fFields.empty()) return false;
+   for (size_t i = 0; i != fFields.size(); ++i) {
+      double lo[3], hi[3];
+      if (!fFields[i]->GetBounds(lo,hi)) return false;
+      for (int j = 0; j != 3; ++j) {
+	 min[j] = i ? std::min(min[j],lo[j]) : lo[j];
+	 max[j] = i ? std::max(max[j],hi[j]) : hi[j];
+      }
+   }
+   return true;
+}
+
+void TCompositeField::Eval(double x, double y, double z,
+			   double *bx, double *by, double *bz) const
+{
+   *bx = *by = *bz = 0.;
+   for (size_t i = 0; i != fFields.size(); ++i) {
+      double b[3];
+      fFields[i]->Eval(x,y,z,b,b+1,b+2);
+      const double w = fScale * fWeights[i];
+      *bx += w * b[0];
+      *by += w * b[1];
+      *bz += w * b[2];
+   }
+}
@@ -0,0 +1,59 @@
+/**
+ * @file   TCompositeField.h
+ * @brief  superposition of magnetic fields
+ *
+ * @date   Created       : 2026-10-17 19:40:12 JST
+ *         Last Modified : 2026-10-17 19:40:12 JST (kawase)
+ * @author KAWASE Shoichiro <kawase@aees.kyushu-u.ac.jp>
+ *
+ *    (C) 2016 KAWASE Shoichiro
+ */
+
+#ifndef INCLUDE_GUARD_UUID_5A18C3E9_6B2F_4D70_B1E4_0F93D7A26C58
+#define INCLUDE_GUARD_UUID_5A18C3E9_6B2F_4D70_B1E4_0F93D7A26C58
+
+#include "TMagneticField.h"
+
+#include <cstddef>
+#include <vector>
+
+namespace art {
+   class TCompositeField;
+}
+
+////////////////////////////////////////////////////////////
+///
+/// Weighted sum of fields, e.g. a field map plus an analytic
+/// correction. The composite owns the fields added to it; its scale
+/// multiplies the sum.
+///
+
+class art::TCompositeField : public TMagneticField {
+public:
+   TCompositeField();
+   ~TCompositeField();
+
+   void Add(TMagneticField *field, double weight = 1.);
+   size_t GetNFields() const {return fFields.size();}
+   TMagneticField* GetField(size_t i) const {return fFields[i];}
+   double GetWeight(size_t i) const {return fWeights[i];}
+   void SetWeight(size_t i, double weight) {fWeights[i] = weight;}
+
+   void Eval(double x, double y, double z,
+	     double *bx, double *by, double *bz) const;
+   bool IsGood() const;
+   // union of the bounds of the fields, false if one has none
+   bool GetBounds(double min[3], double max[3]) const;
+   double GetScale() const {return fScale;}
+   void SetScale(double scale) {fScale = scale;}
+
+private:
+   std::vector<TMagneticField*> fFields;
+   std::vector<double> fWeights;
+   double fScale;
+
+   TCompositeField(const TCompositeField&);            // undefined
+   TCompositeField& operator=(const TCompositeField&); // undefined
+};
+
+#endif // INCLUDE_GUARD_UUID_5A18C3E9_6B2F_4D70_B1E4_0F93D7A26C58
@@ -16,6 +16,7 @@
 
 #include <TObjArray.h>
 #include <TClass.h>
+#include <TMath.h>
 #include <yaml-cpp/yaml.h>
 
 using trace::TDetector;
@@ -25,6 +26,7 @@ Float_t TDetector::fOriginY = 0.;
 Float_t TDetector::fAngle = 0.;
 
 TDetector::TDetector()
+   : fHasArea(kFALSE), fAreaX(0.), fAreaY(0.), fAreaWidth(0.), fAreaAngle(0.)
 {
    fObjects = new TObjArray;
    fObjects->SetOwner(kTRUE);
@@ -56,9 +58,38 @@ trace::TDetector* TDetector::Create(const YAML::Node &node)
       Rotate(detector->fObjects->At(i),fAngle,fOriginX,fOriginY);
    }
 
+   if (detector->fHasArea) {
+      const Double_t c = TMath::Cos(fAngle * TMath::DegToRad());
+      const Double_t s = TMath::Sin(fAngle * TMath::DegToRad());
+      const Double_t x = detector->fAreaX;
+      const Double_t y = detector->fAreaY;
+      detector->fAreaX = fOriginX + c * x - s * y;
+      detector->fAreaY = fOriginY + s * x + c * y;
+      detector->fAreaAngle = fAngle;
+   }
+
    return detector;
 }
 
+void TDetector::SetEffectiveArea(Float_t x, Float_t y, Float_t width)
+{
+   fHasArea = kTRUE;
+   fAreaX = x;
+   fAreaY = y;
+   fAreaWidth = width;
+}
+
+Bool_t TDetector::GetEffectiveArea(Double_t *x, Double_t *y,
+				   Double_t *width, Double_t *angle) const
+{
+   if (!fHasArea) return kFALSE;
+   *x = fAreaX;
+   *y = fAreaY;
+   *width = fAreaWidth;
+   *angle = fAreaAngle;
+   return kTRUE;
+}
+
 void TDetector::Draw(Option_t *opt)
 {
    for(Int_t i = 0; i != fObjects->GetEntriesFast(); ++i) {
@@ -30,12 +30,24 @@ public:
    static void SetAngle(Float_t angle) {fAngle = angle;};
    virtual ~TDetector();
    virtual void Draw(Option_t *);
+   // effective area as a line across the beam in the lab frame: centre
+   // (mm), width (mm) and angle (deg, as that of the end plane);
+   // kFALSE if the detector has none
+   Bool_t GetEffectiveArea(Double_t *x, Double_t *y,
+			   Double_t *width, Double_t *angle) const;
 protected:
    TDetector();
+   // centre and width in the frame of the detector configuration
+   void SetEffectiveArea(Float_t x, Float_t y, Float_t width);
    static Float_t fOriginX;
    static Float_t fOriginY;
    static Float_t fAngle;
    TObjArray *fObjects;
+   Bool_t   fHasArea;
+   Double_t fAreaX;
+   Double_t fAreaY;
+   Double_t fAreaWidth;
+   Double_t fAreaAngle;
 };
 
 #endif // INCLUDE_GUARD_UUID_9905DE04_B61D_48A9_8598_36B6326F2B7A
@@ -31,6 +31,7 @@ TDriftChamber::TDriftChamber(const YAML::Node &node)
    pos[0] >> posX;
    pos[1] >> posY;
 
+   SetName(name.c_str());
    SetTitle(TString::Format("%s (%.2f, %.2f)",
 			    name.c_str(),posX,posY));
 
@@ -59,6 +60,7 @@ TDriftChamber::TDriftChamber(const YAML::Node &node)
       fObjects->Add(MakeRectangle(centerX,centerY,sizeX,sizeY,0,
 				  TAttLine(0,0,1),
 				  TAttFill(kOrange,1001)));
+      SetEffectiveArea(centerX,centerY,sizeX);
    }
 
    { /* make table */
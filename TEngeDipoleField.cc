@@ -0,0 +1,247 @@
+/**
+ * @file   TEngeDipoleField.cc
+ * @brief  analytic dipole field with Enge fringe fields
+ *
+ * @date   Created       : 2026-10-17 19:40:12 JST
+ *         Last Modified : 2026-10-17 19:40:12 JST (kawase)
+ * @author KAWASE Shoichiro <kawase@aees.kyushu-u.ac.jp>
+ *
+ *    (C) 2016 KAWASE Shoichiro
+ */
+
+#include "TEngeDipoleField.h"
+#include "TSamuraiMagnetField.h"
+
+#include <algorithm>
+#include <cmath>
+
+using art::TEngeDipoleField;
+using art::TSamuraiMagnetField;
+
+namespace {
+   /* coefficients of a typical dipole fringe field (H.A. Enge) */
+   const double kDefaultCoefficient[] = {
+      0.478959, 1.911289, -1.185953, 1.630554, -1.082657, 0.318111
+   };
+
+   const double kMinFall = 0.01; // fringe nodes used in the fit
+   const int kNAzimuth = 19;     // 0, 5, .., 90 deg
+   const double kMaxFringe = 10.; // |t| searched for the fringe
+
+   // solve a x = b (n x n, row major) by Gaussian elimination with
+   // partial pivoting; a and b are destroyed
+   bool Solve(std::vector<double> *a, std::vector<double> *b, int n,
+	      std::vector<double> *x)
+   {
+      std::vector<double> &m = *a;
+      std::vector<double> &v = *b;
+      for (int col = 0; col != n; ++col) {
+	 int pivot = col;
+	 for (int row = col + 1; row != n; ++row) {
+	    if (fabs(m[row*n + col]) > fabs(m[pivot*n + col])) pivot = row;
+	 }
+	 if (m[pivot*n + col] == 0.) return false;
+	 if (pivot != col) {
+	    for (int k = 0; k != n; ++k) std::swap(m[col*n + k],m[pivot*n + k]);
+	    std::swap(v[col],v[pivot]);
+	 }
+	 for (int row = col + 1; row != n; ++row) {
+	    const double f = m[row*n + col] / m[col*n + col];
+	    for (int k = col; k != n; ++k) m[row*n + k] -= f * m[col*n + k];
+	    v[row] -= f * v[col];
+	 }
+      }
+      x->assign(n,0.);
+      for (int row = n - 1; row >= 0; --row) {
+	 double s = v[row];
+	 for (int k = row + 1; k != n; ++k) s -= m[row*n + k] * (*x)[k];
+	 (*x)[row] = s / m[row*n + row];
+      }
+      return true;
+   }
+}
+
+TEngeDipoleField::TEngeDipoleField(double centralField, double radius,
+				   double gap)
+   : fB0(centralField), fRadius(radius), fGap(gap),
+     fCoefficient(kDefaultCoefficient,
+		  kDefaultCoefficient
+		  + sizeof(kDefaultCoefficient) / sizeof(kDefaultCoefficient[0])),
+     fScale(1.), fTMin(0.), fTMax(0.)
+{
+   UpdateFringe();
+}
+
+bool TEngeDipoleField::SetCoefficients(const std::vector<double> &c)
+{
+   if (c.empty() || kMaxCoefficient < (int)c.size()) {
+      printf("TEngeDipoleField::SetCoefficients() : 1 to %d coefficients expected, %lu given.\n",
+	     kMaxCoefficient,(unsigned long)c.size());
+      return false;
+   }
+   fCoefficient = c;
+   UpdateFringe();
+   return true;
+}
+
+void TEngeDipoleField::Exponent(double t, double *p, double *dp,
+				double *d2p) const
+{
+   *p = *dp = *d2p = 0.;
+   for (int i = fCoefficient.size() - 1; i >= 0; --i) {
+      *d2p = *d2p * t + 2 * *dp;
+      *dp  = *dp * t + *p;
+      *p   = *p * t + fCoefficient[i];
+   }
+}
+
+void TEngeDipoleField::UpdateFringe()
+{
+   /* walk outwards from t = 0 while the exponent is monotonic and
+      F has not yet reached kMinFall (outside) or 1 - kMinFall (inside) */
+   const double limit = log(1. / kMinFall - 1.);
+   const double dt = 0.01;
+   double p, dp, d2p;
+   Exponent(0.,&p,&dp,&d2p);
+   const double sign = dp < 0. ? -1. : 1.;
+   fTMax = 0.;
+   while (fTMax < kMaxFringe) {
+      Exponent(fTMax + dt,&p,&dp,&d2p);
+      if (sign * dp <= 0.) break;
+      fTMax += dt;
+      if (sign * p >= limit) break;
+   }
+   fTMin = 0.;
+   while (-kMaxFringe < fTMin) {
+      Exponent(fTMin - dt,&p,&dp,&d2p);
+      if (sign * dp <= 0.) break;
+      fTMin -= dt;
+      if (sign * p <= -limit) break;
+   }
+}
+
+void TEngeDipoleField::Fall(double rho, double *f, double *df,
+			    double *d2f) const
+{
+   const double t = (rho - fRadius) / fGap;
+   double p, dp, d2p;
+   if (t > fTMax || t < fTMin) {
+      const double edge = t > fTMax ? fTMax : fTMin;
+      Exponent(edge,&p,&dp,&d2p);
+      p += dp * (t - edge);
+      d2p = 0.;
+   } else {
+      Exponent(t,&p,&dp,&d2p);
+   }
+   /* exp overflows to inf far outside: F = 0 and derivatives 0 */
+   const double e = exp(p);
+   *f = 1. / (1. + e);
+   const double g = *f * (1. - *f);
+   const double dfdt = -g * dp;
+   *df  = dfdt / fGap;
+   *d2f = (-dfdt * (1. - 2. * *f) * dp - g * d2p) / (fGap * fGap);
+}
+
+void TEngeDipoleField::Eval(double x, double y, double z,
+			    double *bx, double *by, double *bz) const
+{
+   const double rho = sqrt(x*x + z*z);
+   double f, df, d2f;
+   Fall(rho,&f,&df,&d2f);
+
+   const double b0 = fScale * fB0;
+   /* F'/rho -> F'' on the axis */
+   const double laplace = d2f + (rho > 0. ? df / rho : d2f);
+   *by = b0 * (f - 0.5 * y * y * laplace);
+   const double brho = b0 * y * df;
+   *bx = rho > 0. ? brho * x / rho : 0.;
+   *bz = rho > 0. ? brho * z / rho : 0.;
+}
+
+bool TEngeDipoleField::Fit(const TSamuraiMagnetField &map, int nCoefficient,
+			   double *rms)
+{
+   if (!map.IsGood() || nCoefficient < 1 || kMaxCoefficient < nCoefficient) {
+      return false;
+   }
+   const TSamuraiFieldFile::Entry &info = map.GetInfo();
+   const double step = std::min(info.fDx,info.fDz);
+   const double rhoMax = std::min(info.fX0 + info.fDx * (info.fNx - 1),
+				  info.fZ0 + info.fDz * (info.fNz - 1));
+   const int nRho = (int)(rhoMax / step);
+   const double b0 = map.GetCentralField();
+   if (b0 == 0. || nRho < 2) {
+      printf("TEngeDipoleField::Fit() : no field at the center of the map.\n");
+      return false;
+   }
+
+   /* midplane profiles along kNAzimuth radii of the quadrant */
+   const double pi = 3.14159265359;
+   std::vector<double> profile((size_t)kNAzimuth * nRho);
+   double radius = 0.;
+   for (int a = 0; a != kNAzimuth; ++a) {
+      const double phi = 0.5 * pi * a / (kNAzimuth - 1);
+      double integral = 0.;
+      for (int i = 0; i != nRho; ++i) {
+	 const double rho = step * i;
+	 double bx, by, bz;
+	 map.Eval(rho * sin(phi),0.,rho * cos(phi),&bx,&by,&bz);
+	 profile[(size_t)a * nRho + i] = by / b0;
+	 if (i) integral += 0.5 * step * (profile[(size_t)a * nRho + i - 1] + by / b0);
+      }
+      radius += integral / kNAzimuth;
+   }
+
+   /* ln(1/F - 1) = sum c_i t^i by the normal equations */
+   const int n = nCoefficient;
+   std::vector<double> ata(n * n,0.), atb(n,0.), c;
+   int nFit = 0;
+   for (size_t s = 0; s != profile.size(); ++s) {
+      const double f = profile[s];
+      if (f <= kMinFall || 1. - kMinFall <= f) continue;
+      const double t = (step * (s % nRho) - radius) / fGap;
+      const double l = log(1. / f - 1.);
+      double ti = 1.;
+      std::vector<double> row(n);
+      for (int i = 0; i != n; ++i, ti *= t) row[i] = ti;
+      for (int i = 0; i != n; ++i) {
+	 for (int j = 0; j != n; ++j) ata[i*n + j] += row[i] * row[j];
+	 atb[i] += row[i] * l;
+      }
+      ++nFit;
+   }
+   if (nFit < n || !Solve(&ata,&atb,n,&c)) {
+      printf("TEngeDipoleField::Fit() : too few fringe nodes (%d) for %d coefficients.\n",
+	     nFit,n);
+      return false;
+   }
+
+   fB0 = b0;
+   fRadius = radius;
+   fCoefficient = c;
+   UpdateFringe();
+
+   if (rms) {
+      double sum = 0.;
+      for (size_t s = 0; s != profile.size(); ++s) {
+	 double f, df, d2f;
+	 Fall(step * (s % nRho),&f,&df,&d2f);
+	 sum += (f - profile[s]) * (f - profile[s]);
+      }
+      *rms = fabs(b0) * sqrt(sum / profile.size());
+   }
+   return true;
+}
+
+void TEngeDipoleField::Print(FILE *fp) const
+{
+   fprintf(fp,"Enge:\n");
+   fprintf(fp,"  CentralField: %.6g\n",fB0);
+   fprintf(fp,"  Radius: %.6g\n",fRadius);
+   fprintf(fp,"  Gap: %.6g\n",fGap);
+   fprintf(fp,"  Coefficients: [");
+   for (size_t i = 0; i != fCoefficient.size(); ++i) {
+      fprintf(fp,"%s%.6g",i ? ", " : "",fCoefficient[i]);
+   }
+   fprintf(fp,"]\n");
+}
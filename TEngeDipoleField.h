@@ -0,0 +1,97 @@
+/**
+ * @file   TEngeDipoleField.h
+ * @brief  analytic dipole field with Enge fringe fields
+ *
+ * @date   Created       : 2026-10-17 19:40:12 JST
+ *         Last Modified : 2026-10-17 19:40:12 JST (kawase)
+ * @author KAWASE Shoichiro <kawase@aees.kyushu-u.ac.jp>
+ *
+ *    (C) 2016 KAWASE Shoichiro
+ */
+
+#ifndef INCLUDE_GUARD_UUID_3D9A6E25_C07B_48F1_8E36_A5B14F9C02D7
+#define INCLUDE_GUARD_UUID_3D9A6E25_C07B_48F1_8E36_A5B14F9C02D7
+
+#include "TMagneticField.h"
+
+#include <cstdio>
+#include <vector>
+
+namespace art {
+   class TEngeDipoleField;
+   class TSamuraiMagnetField;
+}
+
+////////////////////////////////////////////////////////////
+///
+/// Dipole with a circular pole centered on the y axis, evaluated in
+/// closed form. On the midplane
+///
+///   By = B0 F(rho),  F = 1 / (1 + exp(c0 + c1 t + ... + cn t^n)),
+///   t = (rho - R) / D,
+///
+/// with rho = sqrt(x^2 + z^2), R the effective field boundary and D
+/// the gap. Off the midplane the field is expanded to second order in
+/// y from the Laplace equation:
+///
+///   By   = B0 (F - y^2 / 2 (F'' + F' / rho)),
+///   Brho = B0 y F'.
+///
+/// Fit() determines B0, R and c0..cn from the midplane of a field map:
+/// R is the radius of the hard-edge equivalent (the integral of By
+/// along rho over B0, averaged over azimuth), and the coefficients are
+/// the linear least squares solution of ln(1/F - 1) = sum ci t^i over
+/// the map nodes in the fringe (0.01 < F < 0.99).
+///
+/// The polynomial is only meaningful over the fringe: beyond the
+/// points where F reaches 0.01 and 0.99 it is continued linearly, so
+/// that F keeps falling to 0 outside and rising to 1 inside the pole.
+///
+
+class art::TEngeDipoleField : public TMagneticField {
+public:
+   static const int kMaxCoefficient = 8;
+
+   TEngeDipoleField(double centralField = 1., double radius = 1000.,
+		    double gap = 880.);
+
+   void Eval(double x, double y, double z,
+	     double *bx, double *by, double *bz) const;
+   bool IsGood() const {return !fCoefficient.empty();}
+   double GetScale() const {return fScale;}
+   void SetScale(double scale) {fScale = scale;}
+
+   double GetB0() const {return fB0;}
+   void SetB0(double b0) {fB0 = b0;}
+   double GetRadius() const {return fRadius;}
+   void SetRadius(double radius) {fRadius = radius;}
+   double GetGap() const {return fGap;}
+   void SetGap(double gap) {fGap = gap;}
+   const std::vector<double>& GetCoefficients() const {return fCoefficient;}
+   bool SetCoefficients(const std::vector<double> &c);
+
+   // fit B0, R and nCoefficient Enge coefficients to the midplane of
+   // map (gap kept). rms: residual of By over all sampled midplane
+   // points, in the fringe or not (T)
+   bool Fit(const TSamuraiMagnetField &map, int nCoefficient = 6,
+	    double *rms = NULL);
+   // parameters in the syntax of the magnet config
+   void Print(FILE *fp = stdout) const;
+
+private:
+   double fB0;     // T
+   double fRadius; // mm
+   double fGap;    // mm
+   std::vector<double> fCoefficient;
+   double fScale;
+   double fTMin;   // fringe where the polynomial is used
+   double fTMax;
+
+   // F and its first and second derivatives in rho
+   void Fall(double rho, double *f, double *df, double *d2f) const;
+   // polynomial of t and its first and second derivatives
+   void Exponent(double t, double *p, double *dp, double *d2p) const;
+   void UpdateFringe();
+};
+
+#endif // INCLUDE_GUARD_UUID_3D9A6E25_C07B_48F1_8E36_A5B14F9C02D7
@@ -11,6 +11,7 @@
 
 #include "TGeneralConfig.h"
 #include "traceUtil.h"
+#include "TSamuraiTracer.h"
 
 #include <fstream>
 #include <TStyle.h>
@@ -39,7 +40,14 @@ TGeneralConfig::TGeneralConfig(const char* filename)
      fLegendAlign(12), fLegendFont(gStyle->GetTextFont()), fLegendSize(0.018),
      fLegendXOffset(0.12), fLegendYOffset(0.87), fLegendSpacing(0.0225),
      fTrajStyle(1), fTrajWidth(1), fTrajMaxPoint(500), fTrajStepLength(50),
-     fOverwrite(false),
+     fTrajPrecision("double"), fTrajIntegrator("fixed"),
+     fTrajPositionTolerance(art::TSamuraiTracer::kDefaultPositionTolerance),
+     fTrajAngleTolerance(art::TSamuraiTracer::kDefaultAngleTolerance),
+     fTrajMaxStepLength(art::TSamuraiTracer::kDefaultMaxStep),
+     fTrajDriftMargin(art::TSamuraiTracer::kDefaultDriftMargin),
+     fEndPlaneDistance(6750), fEndPlaneAngle(-60),
+     fMaxFlightLength(0), fMaxBendAngle(0), fRecordDetectors(false),
+     fOverwrite(false), fPreviewLevel(0),
      fInputFile(""), fOutFile(kDefaultOutFile),
      fGeoConfigFile(kDefaultGeoConfigFile),
      fMagnetConfigFile(kDefaultMagnetConfigFile)
@@ -100,6 +108,17 @@ void TGeneralConfig::LoadConfigFile(const char* filename)
 	 LoadOptionalScalar(pTraj,"Width",&fTrajWidth);
 	 LoadOptionalScalar(pTraj,"MaxPoint",&fTrajMaxPoint);
 	 LoadOptionalScalar(pTraj,"StepLength",&fTrajStepLength);
+	 LoadOptionalScalar(pTraj,"Precision",&fTrajPrecision);
+	 LoadOptionalScalar(pTraj,"Integrator",&fTrajIntegrator);
+	 LoadOptionalScalar(pTraj,"PositionTolerance",&fTrajPositionTolerance);
+	 LoadOptionalScalar(pTraj,"AngleTolerance",&fTrajAngleTolerance);
+	 LoadOptionalScalar(pTraj,"MaxStepLength",&fTrajMaxStepLength);
+	 LoadOptionalScalar(pTraj,"DriftMargin",&fTrajDriftMargin);
+	 LoadOptionalScalar(pTraj,"EndPlaneDistance",&fEndPlaneDistance);
+	 LoadOptionalScalar(pTraj,"EndPlaneAngle",&fEndPlaneAngle);
+	 LoadOptionalScalar(pTraj,"MaxFlightLength",&fMaxFlightLength);
+	 LoadOptionalScalar(pTraj,"MaxBendAngle",&fMaxBendAngle);
+	 LoadOptionalScalar(pTraj,"RecordDetectors",&fRecordDetectors);
       }
    } catch (YAML::Exception& e) {
       printf("Error occurred while loading config file: %s\n%s\n",
@@ -15,6 +15,8 @@
 #include <TAttLine.h>
 #include <TAttText.h>
 
+#include <string>
+
 namespace trace {
    class TGeneralConfig;
 }
@@ -47,6 +49,17 @@ public:
    short GetTrajectoryWidth() const {return fTrajWidth;}
    short GetTrajectoryMaxPoint() const {return fTrajMaxPoint;}
    float GetTrajectoryStepLength() const {return fTrajStepLength;}
+   const char* GetTrajectoryPrecision() const {return fTrajPrecision.c_str();}
+   const char* GetTrajectoryIntegrator() const {return fTrajIntegrator.c_str();}
+   double GetTrajectoryPositionTolerance() const {return fTrajPositionTolerance;}
+   double GetTrajectoryAngleTolerance() const {return fTrajAngleTolerance;}
+   double GetTrajectoryMaxStepLength() const {return fTrajMaxStepLength;}
+   double GetTrajectoryDriftMargin() const {return fTrajDriftMargin;}
+   double GetEndPlaneDistance() const {return fEndPlaneDistance;}
+   double GetEndPlaneAngle() const {return fEndPlaneAngle;}
+   double GetMaxFlightLength() const {return fMaxFlightLength;}
+   double GetMaxBendAngle() const {return fMaxBendAngle;}
+   bool GetRecordDetectors() const {return fRecordDetectors;}
 
 
    TAttLine GetTrajAttLine(Color_t color = kBlack) const
@@ -65,6 +78,8 @@ public:
 
    bool GetOverwrite() const {return fOverwrite;}
    void SetOverwrite(bool val = true) {fOverwrite = val;}
+   int GetPreviewLevel() const {return fPreviewLevel;}
+   void SetPreviewLevel(int val) {fPreviewLevel = val;}
 
 private:
    void LoadConfigFile(const char*);
@@ -85,8 +100,20 @@ private:
    short fTrajWidth;
    short fTrajMaxPoint;
    float fTrajStepLength;
+   std::string fTrajPrecision; // "double" (default) or "float"
+   std::string fTrajIntegrator; // "fixed" (default) or "adaptive"
+   double fTrajPositionTolerance; // mm
+   double fTrajAngleTolerance;    // rad
+   double fTrajMaxStepLength;     // mm
+   double fTrajDriftMargin;       // mm
+   double fEndPlaneDistance;      // mm
+   double fEndPlaneAngle;         // deg
+   double fMaxFlightLength;       // mm (0: none)
+   double fMaxBendAngle;          // deg (0: none)
+   bool   fRecordDetectors;
 
    bool fOverwrite;
+   int fPreviewLevel;
    const char* fInputFile;
    const char* fOutFile;
    const char* fGeoConfigFile;
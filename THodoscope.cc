@@ -31,6 +31,7 @@ THodoscope::THodoscope(const YAML::Node &node)
    center[0] >> centerX;
    center[1] >> centerY;
 
+   SetName(name.c_str());
    SetTitle(TString::Format("%s (%.2f, %.2f)",
 			    name.c_str(),centerX,centerY));
 
@@ -42,6 +43,7 @@ THodoscope::THodoscope(const YAML::Node &node)
       size[1] >> sizeY;
 
       fObjects->Add(MakeRectangle(centerX,centerY,sizeX,sizeY));
+      SetEffectiveArea(centerX,centerY,sizeX);
    }
 
    { /* make table */
@@ -69,7 +71,7 @@ THodoscope::THodoscope(const YAML::Node &node)
       fObjects->Add(MakeRectangle(centerX,centerY+distance,
 				  sizeX,sizeY,0,
 				  TAttLine(kRed,1,1),
-      				  TAttFill(0,0)));
+				  TAttFill(0,0)));
    }
 }
 
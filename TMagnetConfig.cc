@@ -30,7 +30,14 @@ namespace {
 }
 
 TMagnetConfig::TMagnetConfig()
-   : fFieldFile(""), fCentralField(0.),
+   : fModel("map"), fEngeCentralField(1.), fEngeRadius(1000.),
+     fEngeGap(880.), fEngeCoefficients(),
+     fFieldFile(""), fFieldMap(""),
+     fFieldStorage("mmap"), fFieldLayout("node"),
+     fQuantization("float"), fTileCacheSize(0), fHugePages(""),
+     fNumaReplicate(false), fInterpolation("linear"), fCubicCacheSize(0),
+     fPlanar(false), fBlend(false), fCurrent(0.),
+     fCurrentIsDefined(false), fCentralField(0.),
      fCentralFieldIsDefined(false), fIsGood(false)
 {
 }
@@ -59,7 +66,34 @@ void TMagnetConfig::LoadFile(const char *filename)
       YAML::Parser parser(ifs);
       parser.GetNextDocument(doc);
 
+      LoadOptionalScalar(&doc,"Model",&fModel);
+      if(const YAML::Node *p = doc.FindValue("Enge")) {
+	 LoadOptionalScalar(p,"CentralField",&fEngeCentralField);
+	 LoadOptionalScalar(p,"Radius",&fEngeRadius);
+	 LoadOptionalScalar(p,"Gap",&fEngeGap);
+	 if(const YAML::Node *pc = p->FindValue("Coefficients")) {
+	    fEngeCoefficients.resize(pc->size());
+	    for (size_t i = 0; i != pc->size(); ++i) {
+	       (*pc)[i] >> fEngeCoefficients[i];
+	    }
+	 }
+      }
       LoadOptionalScalar(&doc,"File",&fFieldFile);
+      LoadOptionalScalar(&doc,"Map",&fFieldMap);
+      LoadOptionalScalar(&doc,"Storage",&fFieldStorage);
+      LoadOptionalScalar(&doc,"Layout",&fFieldLayout);
+      LoadOptionalScalar(&doc,"Planar",&fPlanar);
+      LoadOptionalScalar(&doc,"Quantization",&fQuantization);
+      LoadOptionalScalar(&doc,"TileCache",&fTileCacheSize);
+      LoadOptionalScalar(&doc,"HugePages",&fHugePages);
+      LoadOptionalScalar(&doc,"NumaReplicate",&fNumaReplicate);
+      LoadOptionalScalar(&doc,"Interpolation",&fInterpolation);
+      LoadOptionalScalar(&doc,"CubicCache",&fCubicCacheSize);
+      LoadOptionalScalar(&doc,"Blend",&fBlend);
+      if(const YAML::Node *p = doc.FindValue("Current")) {
+	 (*p) >> fCurrent;
+	 fCurrentIsDefined = true;
+      }
       if(const YAML::Node *p = doc.FindValue("CentralField")) {
 	 (*p) >> fCentralField;
 	 fCentralFieldIsDefined = true;
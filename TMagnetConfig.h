@@ -13,6 +13,7 @@
 #define INCLUDE_GUARD_UUID_2557BFA3_A82D_4FAF_A8DD_7F8336CE791C
 
 #include <string>
+#include <vector>
 
 namespace trace {
    class TMagnetConfig;
@@ -23,8 +24,39 @@ public:
    static TMagnetConfig* GetInstance();
    void LoadFile(const char* filename);
 
+   const char* GetModel() const {return fModel.c_str();}
+   void SetModel(const char* model) {fModel = model;}
+   double GetEngeCentralField() const {return fEngeCentralField;}
+   double GetEngeRadius() const {return fEngeRadius;}
+   double GetEngeGap() const {return fEngeGap;}
+   const std::vector<double>& GetEngeCoefficients() const {return fEngeCoefficients;}
    const char* GetFieldFile() const {return fFieldFile.c_str();}
    void SetFieldFile(const char* file) {fFieldFile = file;}
+   const char* GetFieldMap() const {return fFieldMap.c_str();}
+   void SetFieldMap(const char* map) {fFieldMap = map;}
+   const char* GetFieldStorage() const {return fFieldStorage.c_str();}
+   void SetFieldStorage(const char* storage) {fFieldStorage = storage;}
+   const char* GetFieldLayout() const {return fFieldLayout.c_str();}
+   void SetFieldLayout(const char* layout) {fFieldLayout = layout;}
+   const char* GetQuantization() const {return fQuantization.c_str();}
+   void SetQuantization(const char* q) {fQuantization = q;}
+   const char* GetHugePages() const {return fHugePages.c_str();}
+   void SetHugePages(const char* pages) {fHugePages = pages;}
+   bool IsNumaReplicated() const {return fNumaReplicate;}
+   void SetNumaReplicate(bool replicate) {fNumaReplicate = replicate;}
+   int GetTileCacheSize() const {return fTileCacheSize;}
+   void SetTileCacheSize(int n) {fTileCacheSize = n;}
+   const char* GetInterpolation() const {return fInterpolation.c_str();}
+   void SetInterpolation(const char* interpolation) {fInterpolation = interpolation;}
+   int GetCubicCacheSize() const {return fCubicCacheSize;}
+   void SetCubicCacheSize(int n) {fCubicCacheSize = n;}
+   bool IsPlanar() const {return fPlanar;}
+   void SetPlanar(bool planar) {fPlanar = planar;}
+   bool IsBlended() const {return fBlend;}
+   void SetBlend(bool blend) {fBlend = blend;}
+   double GetCurrent() const {return fCurrent;}
+   void SetCurrent(double current) {fCurrent = current; fCurrentIsDefined = true;}
+   bool CurrentIsDefined() const {return fCurrentIsDefined;}
    float GetCentralField() const {return fCentralField;}
    void SetCentralField(float field) {fCentralField = field;}
    bool CentralFieldIsDefined() const;
@@ -35,7 +67,25 @@ private:
    TMagnetConfig(const TMagnetConfig&);            // undefined
    TMagnetConfig& operator=(const TMagnetConfig&); // undefined
 
+   std::string fModel;        // "map" (default), "enge" or "map+enge"
+   double fEngeCentralField;  // T
+   double fEngeRadius;        // effective field boundary (mm)
+   double fEngeGap;           // mm
+   std::vector<double> fEngeCoefficients; // empty: fit to the map
    std::string fFieldFile;
+   std::string fFieldMap;
+   std::string fFieldStorage; // "mmap" (default), "heap" or "shared"
+   std::string fFieldLayout; // "node" (default) or "cell"
+   std::string fQuantization; // "float" (default), "half" or "int16"
+   int fTileCacheSize;        // tiles kept decompressed (0: default)
+   std::string fHugePages;    // "" (no arena), "none", "transparent" or "explicit"
+   bool fNumaReplicate;       // one copy of the map per NUMA node
+   std::string fInterpolation; // "linear" (default) or "cubic"
+   int fCubicCacheSize;       // cells with tricubic coefficients (0: default)
+   bool fPlanar;
+   bool fBlend;               // blend maps to CentralField instead of scaling
+   double fCurrent;           // excitation current to blend maps to (A)
+   bool fCurrentIsDefined;
    float fCentralField;
    bool fCentralFieldIsDefined;
    bool fIsGood;
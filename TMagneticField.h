@@ -0,0 +1,55 @@
+/**
+ * @file   TMagneticField.h
+ * @brief  interface of the magnetic fields the tracer can use
+ *
+ * @date   Created       : 2026-10-17 19:40:12 JST
+ *         Last Modified : 2026-10-17 19:40:12 JST (kawase)
+ * @author KAWASE Shoichiro <kawase@aees.kyushu-u.ac.jp>
+ *
+ *    (C) 2016 KAWASE Shoichiro
+ */
+
+#ifndef INCLUDE_GUARD_UUID_B76E0D42_8F1C_4A3B_9D25_C4E07A6F1B83
+#define INCLUDE_GUARD_UUID_B76E0D42_8F1C_4A3B_9D25_C4E07A6F1B83
+
+namespace art {
+   class TMagneticField;
+}
+
+////////////////////////////////////////////////////////////
+///
+/// Static magnetic field in the frame of the magnet
+/// (x: beam left, y: upward, z: downstream; mm, T).
+///
+/// Implemented by the field map (TSamuraiMagnetField), the analytic
+/// dipole (TEngeDipoleField) and sums of fields (TCompositeField).
+/// The scale multiplies the field returned by Eval(). GetBounds() gives
+/// the box outside which the field is zero, if there is one; the
+/// tracer drifts in straight lines outside it.
+///
+
+class art::TMagneticField {
+public:
+   virtual ~TMagneticField() {}
+
+   virtual void Eval(double x, double y, double z,
+		     double *bx, double *by, double *bz) const = 0;
+   virtual bool IsGood() const = 0;
+   virtual double GetScale() const = 0;
+   virtual void SetScale(double scale) = 0;
+   void ResetScale() {SetScale(1.);}
+   // box outside which Eval() returns 0; false if the field has no bounds
+   virtual bool GetBounds(double * /* min */, double * /* max */) const
+   {return false;}
+
+   // B(upward) at magnet center
+   virtual double GetCentralField() const
+   {
+      if (!IsGood()) return 0.;
+      double bx, by, bz;
+      Eval(0.,0.,0.,&bx,&by,&bz);
+      return by;
+   }
+};
+
+#endif // INCLUDE_GUARD_UUID_B76E0D42_8F1C_4A3B_9D25_C4E07A6F1B83
@@ -0,0 +1,291 @@
+/**
+ * @file   TSamuraiFieldArena.cc
+ * @brief  huge-page backed, NUMA-placed memory for field maps
+ *
+ * @date   Created       : 2026-10-17 15:32:18 JST
+ *         Last Modified : 2026-10-17 15:32:18 JST (kawase)
+ * @author KAWASE Shoichiro <kawase@aees.kyushu-u.ac.jp>
+ *
+ *    (C) 2016 KAWASE Shoichiro
+ */
+
+#include "TSamuraiFieldArena.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+
+#include <dirent.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+using art::TSamuraiFieldArena;
+
+namespace {
+   const size_t kHugeAlign   = 2 << 20;  // THP size on x86_64
+   const int    kMaxNodes    = 1024;
+   const int    kSamplePages = 64;       // pages sampled by Report()
+   const int    kMpolBind    = 2;        // MPOL_BIND in <numaif.h>
+   const unsigned kULongBits = 8 * sizeof(unsigned long);
+
+   __thread int tThreadNode = -1;
+
+   size_t RoundUp(size_t size, size_t unit)
+   {
+      return (size + unit - 1) / unit * unit;
+   }
+
+   // default huge page size from /proc/meminfo (0 if unknown)
+   size_t HugePageSize()
+   {
+      FILE *const fp = fopen("/proc/meminfo","r");
+      if (!fp) return 0;
+      char line[256];
+      unsigned long kb = 0;
+      while (fgets(line,sizeof(line),fp)) {
+	 if (sscanf(line,"Hugepagesize: %lu kB",&kb) == 1) break;
+      }
+      fclose(fp);
+      return (size_t)kb << 10;
+   }
+
+   // bytes backed by transparent huge pages in the mapping containing addr
+   size_t TransparentHugeBytes(const void *addr)
+   {
+      FILE *const fp = fopen("/proc/self/smaps","r");
+      if (!fp) return 0;
+      const unsigned long a = (unsigned long)addr;
+      char line[512];
+      bool inside = false;
+      unsigned long kb = 0;
+      while (fgets(line,sizeof(line),fp)) {
+	 unsigned long begin, end;
+	 if (sscanf(line,"%lx-%lx ",&begin,&end) == 2) {
+	    if (inside) break;
+	    inside = (begin <= a && a < end);
+	 } else if (inside && sscanf(line,"AnonHugePages: %lu kB",&kb) == 1) {
+	    break;
+	 }
+      }
+      fclose(fp);
+      return (size_t)kb << 10;
+   }
+
+   bool BindMemory(void *addr, size_t length, int node)
+   {
+      if (node < 0 || kMaxNodes <= node) return false;
+      unsigned long mask[kMaxNodes / (8 * sizeof(unsigned long))];
+      memset(mask,0,sizeof(mask));
+      mask[node / kULongBits] |= 1UL << (node % kULongBits);
+      return !syscall(SYS_mbind,addr,length,kMpolBind,mask,
+		      (unsigned long)kMaxNodes + 1,0);
+   }
+
+   const char* PagesName(TSamuraiFieldArena::EPages pages)
+   {
+      switch (pages) {
+	 case TSamuraiFieldArena::kTransparentHuge: return "transparent huge";
+	 case TSamuraiFieldArena::kExplicitHuge:    return "explicit huge";
+	 default:                                   return "small";
+      }
+   }
+}
+
+TSamuraiFieldArena::TSamuraiFieldArena()
+   : fBlocks()
+{
+}
+
+TSamuraiFieldArena::~TSamuraiFieldArena()
+{
+   Release();
+}
+
+void* TSamuraiFieldArena::Allocate(size_t size, EPages pages, int node,
+				   const char* label)
+{
+   Block block;
+   block.fAddress   = MAP_FAILED;
+   block.fSize      = size;
+   block.fRequested = pages;
+   block.fPages     = pages;
+   block.fNode      = node;
+   block.fLabel     = label;
+
+#ifdef MAP_HUGETLB
+   const size_t huge = HugePageSize();
+   if (pages == kExplicitHuge && huge) {
+      block.fLength  = RoundUp(size,huge);
+      block.fAddress = mmap(NULL,block.fLength,PROT_READ | PROT_WRITE,
+			    MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB,-1,0);
+   }
+#endif
+   if (block.fAddress == MAP_FAILED && pages == kExplicitHuge) {
+      printf("TSamuraiFieldArena::Allocate() : no explicit huge pages, using transparent huge pages.\n");
+      block.fPages = kTransparentHuge;
+   }
+
+   if (block.fAddress == MAP_FAILED) {
+      /* over-allocate and trim so that the block is 2 MB aligned */
+      const size_t align = block.fPages == kTransparentHuge
+	 ? kHugeAlign : (size_t)sysconf(_SC_PAGESIZE);
+      block.fLength = RoundUp(size,align);
+      const size_t length = block.fLength + align;
+      char *const raw = static_cast<char*>(mmap(NULL,length,PROT_READ | PROT_WRITE,
+						MAP_PRIVATE | MAP_ANONYMOUS,-1,0));
+      if (raw == MAP_FAILED) {
+	 printf("TSamuraiFieldArena::Allocate() : Cannot map %lu MB for %s.\n",
+		size >> 20,label);
+	 return NULL;
+      }
+      char *const addr = raw + (align - (unsigned long)raw % align) % align;
+      if (addr != raw) munmap(raw,addr - raw);
+      if (raw + length != addr + block.fLength) {
+	 munmap(addr + block.fLength,raw + length - (addr + block.fLength));
+      }
+      block.fAddress = addr;
+#ifdef MADV_HUGEPAGE
+      if (block.fPages == kTransparentHuge) {
+	 madvise(addr,block.fLength,MADV_HUGEPAGE);
+      }
+#endif
+   }
+
+   /* has to precede the first touch */
+   if (node >= 0 && !BindMemory(block.fAddress,block.fLength,node)) {
+      printf("TSamuraiFieldArena::Allocate() : Cannot bind %s to node %d.\n",
+	     label,node);
+      block.fNode = -1;
+   }
+
+   fBlocks.push_back(block);
+   return block.fAddress;
+}
+
+void TSamuraiFieldArena::Release()
+{
+   for (size_t i = 0; i != fBlocks.size(); ++i) {
+      munmap(fBlocks[i].fAddress,fBlocks[i].fLength);
+   }
+   fBlocks.clear();
+}
+
+void TSamuraiFieldArena::Report(FILE *fp) const
+{
+   const size_t page = sysconf(_SC_PAGESIZE);
+   for (size_t i = 0; i != fBlocks.size(); ++i) {
+      const Block &block = fBlocks[i];
+
+      /* page size obtained */
+      size_t pageSize = page;
+      size_t hugeBytes = 0;
+      if (block.fPages == kExplicitHuge) {
+	 pageSize  = HugePageSize();
+	 hugeBytes = block.fLength;
+      } else if (block.fPages == kTransparentHuge) {
+	 hugeBytes = std::min(TransparentHugeBytes(block.fAddress),block.fLength);
+	 if (hugeBytes) pageSize = kHugeAlign;
+      }
+
+      /* node placement of sampled pages */
+      const size_t nPage = block.fLength / page;
+      const int nSample = (int)std::min<size_t>(kSamplePages,nPage);
+      std::vector<void*> pages(nSample);
+      std::vector<int> status(nSample,-1);
+      for (int n = 0; n != nSample; ++n) {
+	 pages[n] = (char*)block.fAddress + (nPage * n / nSample) * page;
+      }
+      std::map<int,int> placement;
+      if (nSample && !syscall(SYS_move_pages,0,(unsigned long)nSample,&pages[0],
+			      NULL,&status[0],0)) {
+	 for (int n = 0; n != nSample; ++n) {
+	    if (status[n] >= 0) ++placement[status[n]];
+	 }
+      }
+
+      fprintf(fp,"field arena: %s, %lu MB, %s pages requested, %lu kB pages obtained",
+	      block.fLabel.c_str(),block.fSize >> 20,PagesName(block.fRequested),
+	      pageSize >> 10);
+      if (block.fPages != block.fRequested) {
+	 fprintf(fp,", fell back to %s pages",PagesName(block.fPages));
+      }
+      if (block.fPages == kTransparentHuge) {
+	 fprintf(fp," (%.0f%% huge)",100. * hugeBytes / block.fLength);
+      }
+      if (block.fNode >= 0) fprintf(fp,", bound to node %d",block.fNode);
+      if (placement.empty()) {
+	 fprintf(fp,", placement unknown\n");
+	 continue;
+      }
+      for (std::map<int,int>::const_iterator it = placement.begin();
+	   it != placement.end(); ++it) {
+	 fprintf(fp,", %.0f%% on node %d",100. * it->second / nSample,it->first);
+      }
+      fprintf(fp,"\n");
+   }
+}
+
+int TSamuraiFieldArena::GetNumNodes()
+{
+   DIR *const dir = opendir("/sys/devices/system/node");
+   if (!dir) return 1;
+   int nNode = 1;
+   while (const struct dirent *const entry = readdir(dir)) {
+      int node;
+      if (sscanf(entry->d_name,"node%d",&node) == 1) {
+	 nNode = std::max(nNode,node + 1);
+      }
+   }
+   closedir(dir);
+   return nNode;
+}
+
+bool TSamuraiFieldArena::BindThread(int node)
+{
+   char path[64];
+   snprintf(path,sizeof(path),"/sys/devices/system/node/node%d/cpulist",node);
+   FILE *const fp = fopen(path,"r");
+   if (!fp) {
+      tThreadNode = 0;
+      return node == 0; // no NUMA: everything is node 0
+   }
+
+   /* cpulist is like "0-15,32-47" */
+   cpu_set_t cpus;
+   CPU_ZERO(&cpus);
+   int first, last;
+   char sep;
+   while (fscanf(fp,"%d",&first) == 1) {
+      last = first;
+      if (fscanf(fp,"%c",&sep) == 1 && sep == '-') {
+	 if (fscanf(fp,"%d",&last) != 1) break;
+	 if (fscanf(fp,"%c",&sep) != 1) sep = '\n';
+      }
+      for (int cpu = first; cpu <= last && cpu < CPU_SETSIZE; ++cpu) {
+	 CPU_SET(cpu,&cpus);
+      }
+      if (sep != ',') break;
+   }
+   fclose(fp);
+
+   if (!CPU_COUNT(&cpus) || sched_setaffinity(0,sizeof(cpus),&cpus)) {
+      printf("TSamuraiFieldArena::BindThread() : Cannot bind thread to node %d.\n",node);
+      return false;
+   }
+   tThreadNode = node;
+   return true;
+}
+
+int TSamuraiFieldArena::GetThreadNode()
+{
+   if (tThreadNode < 0) {
+      /* not bound: stay with the node the thread first ran on */
+      unsigned cpu = 0, node = 0;
+      if (syscall(SYS_getcpu,&cpu,&node,NULL)) node = 0;
+      tThreadNode = node;
+   }
+   return tThreadNode;
+}
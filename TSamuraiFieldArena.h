@@ -0,0 +1,77 @@
+/**
+ * @file   TSamuraiFieldArena.h
+ * @brief  huge-page backed, NUMA-placed memory for field maps
+ *
+ * @date   Created       : 2026-10-17 15:32:18 JST
+ *         Last Modified : 2026-10-17 15:32:18 JST (kawase)
+ * @author KAWASE Shoichiro <kawase@aees.kyushu-u.ac.jp>
+ *
+ *    (C) 2016 KAWASE Shoichiro
+ */
+
+#ifndef INCLUDE_GUARD_UUID_8B1D4F60_7C2E_4A35_9E8B_3F06D5A2C917
+#define INCLUDE_GUARD_UUID_8B1D4F60_7C2E_4A35_9E8B_3F06D5A2C917
+
+#include <cstddef>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace art {
+   class TSamuraiFieldArena;
+}
+
+////////////////////////////////////////////////////////////
+///
+/// Anonymous mappings for field arrays. Each block is either backed by
+/// ordinary pages, advised to use transparent huge pages
+/// (madvise(MADV_HUGEPAGE), 2 MB aligned) or allocated from the
+/// explicit huge page pool (MAP_HUGETLB, falling back to transparent
+/// huge pages when the pool is empty). A block may be bound to one
+/// NUMA node with mbind() before it is first touched.
+///
+/// Report() prints per block the page size and the node placement the
+/// kernel actually gave, sampled from /proc/self/smaps and
+/// move_pages(2), since both requests may be silently downgraded.
+///
+/// BindThread() pins the calling thread to the CPUs of a node and
+/// records the node; GetThreadNode() returns it (or the node the
+/// thread currently runs on) so that lookups can pick the local
+/// replica. NUMA calls are made through syscall(2), so no libnuma is
+/// needed; on kernels without NUMA support everything is node 0.
+///
+
+class art::TSamuraiFieldArena {
+public:
+   enum EPages { kSmallPages, kTransparentHuge, kExplicitHuge };
+
+   TSamuraiFieldArena();
+   ~TSamuraiFieldArena();
+
+   // node < 0: no binding. returns NULL on failure
+   void* Allocate(size_t size, EPages pages, int node = -1,
+		  const char* label = "");
+   void Release();
+   void Report(FILE *fp = stdout) const;
+
+   static int GetNumNodes();
+   static bool BindThread(int node);
+   static int GetThreadNode();
+
+private:
+   struct Block {
+      void       *fAddress;
+      size_t      fLength;
+      size_t      fSize;
+      EPages      fRequested;
+      EPages      fPages;
+      int         fNode;
+      std::string fLabel;
+   };
+   std::vector<Block> fBlocks;
+
+   TSamuraiFieldArena(const TSamuraiFieldArena&);            // undefined
+   TSamuraiFieldArena& operator=(const TSamuraiFieldArena&); // undefined
+};
+
+#endif // INCLUDE_GUARD_UUID_8B1D4F60_7C2E_4A35_9E8B_3F06D5A2C917
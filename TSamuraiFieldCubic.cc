@@ -0,0 +1,185 @@
+/**
+ * @file   TSamuraiFieldCubic.cc
+ * @brief  tricubic interpolation coefficients of a field map
+ *
+ * @date   Created       : 2026-10-17 18:51:37 JST
+ *         Last Modified : 2026-10-17 18:51:37 JST (kawase)
+ * @author KAWASE Shoichiro <kawase@aees.kyushu-u.ac.jp>
+ *
+ *    (C) 2016 KAWASE Shoichiro
+ */
+
+#include "TSamuraiFieldCubic.h"
+
+#include <algorithm>
+
+using art::TSamuraiFieldCubic;
+
+namespace {
+   /* Catmull-Rom: f(t) = sum_a t^a sum_m kSpline[a][m] f_(m-1) */
+   const double kSpline[4][4] = {
+      {  0.0,  1.0,  0.0,  0.0 },
+      { -0.5,  0.0,  0.5,  0.0 },
+      {  1.0, -2.5,  2.0, -0.5 },
+      { -0.5,  1.5, -1.5,  0.5 },
+   };
+
+   // fill the stencil values g[0] (below) and g[3] (above) lying
+   // beyond the map
+   inline void Extend(double *g, size_t stride,
+		      bool below, bool above, bool mirror)
+   {
+      if (below) g[0] = mirror ? g[2*stride] : 2*g[stride] - g[2*stride];
+      if (above) g[3*stride] = 2*g[2*stride] - g[stride];
+   }
+
+   // node values -> power coefficients along one axis
+   inline void Transform(double *g, size_t stride)
+   {
+      double v[4];
+      for (int m = 0; m != 4; ++m) v[m] = g[m*stride];
+      for (int a = 0; a != 4; ++a) {
+	 g[a*stride] = kSpline[a][0]*v[0] + kSpline[a][1]*v[1]
+	    + kSpline[a][2]*v[2] + kSpline[a][3]*v[3];
+      }
+   }
+
+   inline int Clamp(int i, int n)
+   {
+      return i < 0 ? 0 : (n <= i ? n - 1 : i);
+   }
+}
+
+TSamuraiFieldCubic::TSamuraiFieldCubic(const float *data,
+				       int nx, int ny, int nz,
+				       bool mirrorX, bool mirrorZ,
+				       size_t capacity)
+   : fData(data), fNx(nx), fNy(ny), fNz(nz),
+     fMirrorX(mirrorX), fMirrorZ(mirrorZ),
+     fKey(), fCoef(), fHits(0), fMisses(0)
+{
+   SetCapacity(capacity);
+}
+
+void TSamuraiFieldCubic::SetCapacity(size_t capacity)
+{
+   if (!capacity) capacity = 1;
+   fKey.assign(capacity,0);
+   fCoef.assign(capacity * 3 * kNCoef,0.);
+}
+
+size_t TSamuraiFieldCubic::GetResidentBytes() const
+{
+   return fCoef.size() * sizeof(double);
+}
+
+void TSamuraiFieldCubic::Compute(int i, int j, int k, double *coef) const
+{
+   const size_t strideY = (size_t)fNz * 3;
+   const size_t strideX = (size_t)fNy * strideY;
+   const bool xb = i == 0, xa = fNx <= i + 2;
+   const bool yb = j == 0, ya = fNy <= j + 2;
+   const bool zb = k == 0, za = fNz <= k + 2;
+
+   for (int axis = 0; axis != 3; ++axis) {
+      double g[4][4][4];
+      for (int ii = 0; ii != 4; ++ii) {
+	 for (int jj = 0; jj != 4; ++jj) {
+	    const float *const row = fData + axis
+	       + Clamp(i + ii - 1,fNx) * strideX + Clamp(j + jj - 1,fNy) * strideY;
+	    for (int kk = 0; kk != 4; ++kk) {
+	       g[ii][jj][kk] = row[Clamp(k + kk - 1,fNz) * 3];
+	    }
+	 }
+      }
+
+      /* one axis after the other; values loaded from clamped indices
+	 are replaced by Extend before they are used */
+      for (int ii = 0; ii != 4; ++ii) {
+	 for (int jj = 0; jj != 4; ++jj) {
+	    Extend(&g[ii][jj][0],1,zb,za,fMirrorZ);
+	    Transform(&g[ii][jj][0],1);
+	 }
+      }
+      for (int ii = 0; ii != 4; ++ii) {
+	 for (int kk = 0; kk != 4; ++kk) {
+	    Extend(&g[ii][0][kk],4,yb,ya,false);
+	    Transform(&g[ii][0][kk],4);
+	 }
+      }
+      for (int jj = 0; jj != 4; ++jj) {
+	 for (int kk = 0; kk != 4; ++kk) {
+	    Extend(&g[0][jj][kk],16,xb,xa,fMirrorX);
+	    Transform(&g[0][jj][kk],16);
+	 }
+      }
+      std::copy(&g[0][0][0],&g[0][0][0] + kNCoef,coef + axis * kNCoef);
+   }
+}
+
+const double* TSamuraiFieldCubic::Coefficients(int i, int j, int k) const
+{
+   const size_t cell = ((size_t)i * (fNy-1) + j) * (fNz-1) + k;
+   const size_t slot = cell % fKey.size();
+   double *const coef = &fCoef[slot * 3 * kNCoef];
+   if (fKey[slot] == cell + 1) {
+      ++fHits;
+   } else {
+      ++fMisses;
+      Compute(i,j,k,coef);
+      fKey[slot] = cell + 1;
+   }
+   return coef;
+}
+
+void TSamuraiFieldCubic::Eval(int i, int j, int k,
+			      double p, double q, double r,
+			      double b[3]) const
+{
+   const double *const coef = Coefficients(i,j,k);
+   for (int axis = 0; axis != 3; ++axis) {
+      /* Horner in r, q and p */
+      const double *const c = coef + axis * kNCoef;
+      double sp = 0.;
+      for (int a = 3; a >= 0; --a) {
+	 double sq = 0.;
+	 for (int bb = 3; bb >= 0; --bb) {
+	    const double *const d = c + a * 16 + bb * 4;
+	    sq = sq * q + (((d[3] * r + d[2]) * r + d[1]) * r + d[0]);
+	 }
+	 sp = sp * p + sq;
+      }
+      b[axis] = sp;
+   }
+}
+
+void TSamuraiFieldCubic::EvalWithGradient(int i, int j, int k,
+					  double p, double q, double r,
+					  double b[3], double d[3][3]) const
+{
+   const double *const coef = Coefficients(i,j,k);
+   for (int axis = 0; axis != 3; ++axis) {
+      /* Horner with derivatives: P' <- P' t + P before P <- P t + c */
+      const double *const c = coef + axis * kNCoef;
+      double sp = 0., spp = 0., spq = 0., spr = 0.;
+      for (int a = 3; a >= 0; --a) {
+	 double sq = 0., sqq = 0., sqr = 0.;
+	 for (int bb = 3; bb >= 0; --bb) {
+	    const double *const e = c + a * 16 + bb * 4;
+	    const double sr  = ((e[3] * r + e[2]) * r + e[1]) * r + e[0];
+	    const double srr = (3 * e[3] * r + 2 * e[2]) * r + e[1];
+	    sqq = sqq * q + sq;
+	    sq  = sq * q + sr;
+	    sqr = sqr * q + srr;
+	 }
+	 spp = spp * p + sp;
+	 sp  = sp * p + sq;
+	 spq = spq * p + sqq;
+	 spr = spr * p + sqr;
+      }
+      b[axis] = sp;
+      d[axis][0] = spp;
+      d[axis][1] = spq;
+      d[axis][2] = spr;
+   }
+}
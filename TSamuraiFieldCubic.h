@@ -0,0 +1,82 @@
+/**
+ * @file   TSamuraiFieldCubic.h
+ * @brief  tricubic interpolation coefficients of a field map
+ *
+ * @date   Created       : 2026-10-17 18:51:37 JST
+ *         Last Modified : 2026-10-17 18:51:37 JST (kawase)
+ * @author KAWASE Shoichiro <kawase@aees.kyushu-u.ac.jp>
+ *
+ *    (C) 2016 KAWASE Shoichiro
+ */
+
+#ifndef INCLUDE_GUARD_UUID_2C8E5B71_A3D6_4F29_9B04_7E1F6C3D85A0
+#define INCLUDE_GUARD_UUID_2C8E5B71_A3D6_4F29_9B04_7E1F6C3D85A0
+
+#include <cstddef>
+#include <vector>
+
+namespace art {
+   class TSamuraiFieldCubic;
+}
+
+////////////////////////////////////////////////////////////
+///
+/// Tricubic interpolation in a node-major float map: the tensor
+/// product of Catmull-Rom splines through the 4x4x4 nodes around a
+/// cell. The field is C1 across cell faces (trilinear interpolation is
+/// only C0) and linear fields are reproduced exactly.
+///
+/// Each cell is a polynomial sum c_abc p^a q^b r^c (a,b,c = 0..3) per
+/// component, i.e. 192 coefficients (1.5 kB). Computing them for all
+/// cells of the SAMURAI map would take 11 GB, so they are computed when
+/// a cell is first evaluated and kept in a direct-mapped cache of
+/// GetCapacity() cells; a trajectory touches a few thousand cells.
+///
+/// Nodes beyond the map are extrapolated linearly, except below the
+/// first plane of a mirrored axis (x = 0 or z = 0), where the mirror
+/// image of the map is used.
+///
+/// Not thread safe: the cache is modified by const lookups.
+///
+
+class art::TSamuraiFieldCubic {
+public:
+   static const size_t kDefaultCapacity = 8192;
+   static const int kNCoef = 64; // per component
+
+   TSamuraiFieldCubic(const float *data, int nx, int ny, int nz,
+		      bool mirrorX, bool mirrorZ,
+		      size_t capacity = kDefaultCapacity);
+
+   // unscaled field in cell (i,j,k) at local coordinate (p,q,r)
+   void Eval(int i, int j, int k, double p, double q, double r,
+	     double b[3]) const;
+   // the same with d[axis][n] = d b[axis] / d (p,q,r)[n]
+   void EvalWithGradient(int i, int j, int k, double p, double q, double r,
+			 double b[3], double d[3][3]) const;
+
+   size_t GetCapacity() const {return fKey.size();}
+   void SetCapacity(size_t capacity);
+   unsigned long GetHits() const {return fHits;}
+   unsigned long GetMisses() const {return fMisses;}
+   size_t GetResidentBytes() const;
+
+private:
+   const float *fData;     // [fNx][fNy][fNz][3]
+   int    fNx, fNy, fNz;
+   bool   fMirrorX;        // node -1 in x is the image of node 1
+   bool   fMirrorZ;        // node -1 in z is the image of node 1
+
+   mutable std::vector<size_t> fKey;  // cell + 1 held by a slot, 0 if none
+   mutable std::vector<double> fCoef; // [slot][3][kNCoef]
+   mutable unsigned long fHits;
+   mutable unsigned long fMisses;
+
+   const double* Coefficients(int i, int j, int k) const;
+   void Compute(int i, int j, int k, double *coef) const;
+
+   TSamuraiFieldCubic(const TSamuraiFieldCubic&);            // undefined
+   TSamuraiFieldCubic& operator=(const TSamuraiFieldCubic&); // undefined
+};
+
+#endif // INCLUDE_GUARD_UUID_2C8E5B71_A3D6_4F29_9B04_7E1F6C3D85A0
@@ -0,0 +1,127 @@
+/**
+ * @file   TSamuraiFieldCursor.cc
+ * @brief  field lookup that remembers the cell of the previous point
+ *
+ * @date   Created       : 2026-10-17 18:24:10 JST
+ *         Last Modified : 2026-10-17 18:24:10 JST (kawase)
+ * @author KAWASE Shoichiro <kawase@aees.kyushu-u.ac.jp>
+ *
+ *    (C) 2016 KAWASE Shoichiro
+ */
+
+#include "TSamuraiFieldCursor.h"
+#include "TSamuraiMagnetField.h"
+
+#include <cmath>
+
+using art::TSamuraiFieldCursor;
+using art::TSamuraiMagnetField;
+
+TSamuraiFieldCursor::TSamuraiFieldCursor()
+   : fField(NULL), fTarget(NULL), fHits(0), fMisses(0), fPrefetches(0)
+{
+   fCell[0] = fCell[1] = fCell[2] = -1;
+   fAhead[0] = fAhead[1] = fAhead[2] = 0.;
+}
+
+void TSamuraiFieldCursor::Reset(const TSamuraiMagnetField *field)
+{
+   fField = field;
+   fTarget = field && field->fLevel ? field->fPyramid[field->fLevel-1] : field;
+   fCell[0] = fCell[1] = fCell[2] = -1;
+}
+
+void TSamuraiFieldCursor::Eval(double x, double y, double z,
+			       double *bx, double *by, double *bz)
+{
+   const TSamuraiMagnetField *const t = fTarget;
+   if (!t) {
+      *bx = *by = *bz = 0;
+      return;
+   }
+   if (t->fCubic
+       || (t->fMidplane && fabs(y) <= TSamuraiMagnetField::kPlanarTolerance)) {
+      /* tricubic lookups keep their own coefficient cache */
+      fField->Eval(x,y,z,bx,by,bz);
+      return;
+   }
+
+   int i,j,k;
+   double p,q,r;
+   const bool inside = t->FindCell(x,y,z,&i,&j,&k,&p,&q,&r);
+#ifdef SAMURAI_FIELD_STATS
+   t->Record(inside,i,j,k);
+#endif
+   if (!inside) {
+      *bx = *by = *bz = 0;
+      return;
+   }
+
+   if (i == fCell[0] && j == fCell[1] && k == fCell[2]) {
+      ++fHits;
+   } else {
+      ++fMisses;
+      const float *f[TSamuraiMagnetField::kCorner];
+      float decoded[TSamuraiMagnetField::kCellSize];
+      if (!t->CellCorners(i,j,k,f,decoded)) {
+	 fCell[0] = -1;
+	 *bx = *by = *bz = 0;
+	 return;
+      }
+      for (int n = 0; n != TSamuraiMagnetField::kCorner; ++n) {
+	 for (int axis = 0; axis != TSamuraiMagnetField::kDimension; ++axis) {
+	    fCorner[n * TSamuraiMagnetField::kDimension + axis] = f[n][axis];
+	 }
+      }
+      fCell[0] = i;
+      fCell[1] = j;
+      fCell[2] = k;
+
+      /* the cell the next point will probably be in */
+      int ia,ja,ka;
+      double pa,qa,ra;
+      if ((fAhead[0] || fAhead[1] || fAhead[2])
+	  && t->FindCell(x + fAhead[0],y + fAhead[1],z + fAhead[2],
+			 &ia,&ja,&ka,&pa,&qa,&ra)
+	  && (ia != i || ja != j || ka != k)) {
+	 t->PrefetchCell(ia,ja,ka);
+	 ++fPrefetches;
+      }
+   }
+
+   /* trilinear interpolation as in TSamuraiMagnetField::Interpolate */
+   double c[3];
+   for (int axis = 0; axis != 3; ++axis) {
+      const float *const f = fCorner + axis;
+      const double c00 = (1-p)*f[0] + p*f[12];
+      const double c01 = (1-p)*f[3] + p*f[15];
+      const double c10 = (1-p)*f[6] + p*f[18];
+      const double c11 = (1-p)*f[9] + p*f[21];
+
+      const double c0 = (1-q)*c00 + q*c10;
+      const double c1 = (1-q)*c01 + q*c11;
+
+      c[axis] = (1-r)*c0 + r*c1;
+   }
+
+   *bx = t->fScale * c[0];
+   *by = t->fScale * c[1];
+   *bz = t->fScale * c[2];
+   if (t != fField) {
+      *bx *= fField->fScale;
+      *by *= fField->fScale;
+      *bz *= fField->fScale;
+   }
+}
+
+double TSamuraiFieldCursor::GetHitRate() const
+{
+   const unsigned long n = fHits + fMisses;
+   return n ? (double)fHits / n : 0.;
+}
+
+void TSamuraiFieldCursor::Print(FILE *fp) const
+{
+   fprintf(fp,"field cursor: %lu hits, %lu misses (hit rate %.1f %%), %lu cells prefetched\n",
+	   fHits,fMisses,100. * GetHitRate(),fPrefetches);
+}
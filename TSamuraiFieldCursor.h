@@ -0,0 +1,75 @@
+/**
+ * @file   TSamuraiFieldCursor.h
+ * @brief  field lookup that remembers the cell of the previous point
+ *
+ * @date   Created       : 2026-10-17 18:24:10 JST
+ *         Last Modified : 2026-10-17 18:24:10 JST (kawase)
+ * @author KAWASE Shoichiro <kawase@aees.kyushu-u.ac.jp>
+ *
+ *    (C) 2016 KAWASE Shoichiro
+ */
+
+#ifndef INCLUDE_GUARD_UUID_9F3C6A18_2B7D_4E50_A4C9_6D81E2F5B037
+#define INCLUDE_GUARD_UUID_9F3C6A18_2B7D_4E50_A4C9_6D81E2F5B037
+
+#include <cstdio>
+
+namespace art {
+   class TSamuraiFieldCursor;
+   class TSamuraiMagnetField;
+}
+
+////////////////////////////////////////////////////////////
+///
+/// Evaluation state of one trajectory. Successive points of a trace
+/// are close to each other, so the cursor keeps the 8 corners x 3
+/// components of the last cell it interpolated in and reuses them as
+/// long as the point stays in that cell (a hit); only entering another
+/// cell loads corners from the map (a miss).
+///
+/// On a miss the cell containing the point displaced by the look-ahead
+/// (SetLookAhead(), map frame) is prefetched, so that its corners are
+/// on the way to the cache while the caller integrates the current
+/// step. The tracer sets the look-ahead to one step along the momentum.
+/// Prefetch is done for float maps only (tiles and quantized maps are
+/// decoded on access). With tricubic interpolation the cursor passes
+/// lookups on to the field, whose coefficient cache plays its role.
+///
+/// The interpolation is that of the generic path of
+/// TSamuraiMagnetField::Eval(), with the field scale applied at each
+/// call, so the field may be rescaled while a cursor is in use. After
+/// any other change of the field (layout, level, blend, ...) Reset()
+/// has to be called.
+///
+
+class art::TSamuraiFieldCursor {
+public:
+   TSamuraiFieldCursor();
+
+   // forget the cached cell and evaluate field from now on (counters are kept)
+   void Reset(const TSamuraiMagnetField *field);
+   void SetLookAhead(double dx, double dy, double dz)
+   { fAhead[0] = dx; fAhead[1] = dy; fAhead[2] = dz; }
+   void Eval(double x, double y, double z,
+	     double *bx, double *by, double *bz);
+
+   unsigned long GetHits() const {return fHits;}
+   unsigned long GetMisses() const {return fMisses;}
+   unsigned long GetPrefetches() const {return fPrefetches;}
+   double GetHitRate() const;
+   void ResetCounters() {fHits = fMisses = fPrefetches = 0;}
+   void Print(FILE *fp = stdout) const;
+
+private:
+   const TSamuraiMagnetField *fField;  // field evaluated
+   const TSamuraiMagnetField *fTarget; // level actually read
+   int    fCell[3];      // cached cell, fCell[0] < 0 if none
+   float  fCorner[24];   // [corner][component] of the cached cell
+   double fAhead[3];     // look-ahead displacement (mm)
+
+   unsigned long fHits;
+   unsigned long fMisses;
+   unsigned long fPrefetches;
+};
+
+#endif // INCLUDE_GUARD_UUID_9F3C6A18_2B7D_4E50_A4C9_6D81E2F5B037
@@ -0,0 +1,262 @@
+/**
+ * @file   TSamuraiFieldFile.cc
+ * @brief  Indexed container for SAMURAI magnet field maps
+ *
+ * @date   Created       : 2026-10-17 10:12:31 JST
+ *         Last Modified : 2026-10-17 10:12:31 JST (kawase)
+ * @author KAWASE Shoichiro <kawase@aees.kyushu-u.ac.jp>
+ *
+ *    (C) 2016 KAWASE Shoichiro
+ */
+
+#include "TSamuraiFieldFile.h"
+
+#include <algorithm>
+#include <fstream>
+#include <cstdio>
+#include <cstring>
+
+#include <zlib.h>
+
+using art::TSamuraiFieldFile;
+
+const char TSamuraiFieldFile::kMagic[8] = {'S','A','M','F','I','E','L','D'};
+
+namespace {
+   const uint64_t kAlignment = 4096; // payloads start on page boundaries
+
+   inline uint64_t Align(uint64_t pos)
+   {
+      return (pos + kAlignment - 1) / kAlignment * kAlignment;
+   }
+}
+
+TSamuraiFieldFile::TSamuraiFieldFile()
+   : fFileName(""), fEntries()
+{
+}
+
+bool TSamuraiFieldFile::Open(const char* filename)
+{
+   fEntries.clear();
+   fFileName = filename;
+
+   std::ifstream ifs(filename,std::ios::binary);
+   if (!ifs) return false;
+
+   Header header;
+   if (!ifs.read((char*)&header,sizeof(header))
+       || memcmp(header.fMagic,kMagic,sizeof(kMagic))) {
+      return false;
+   }
+
+   if (header.fVersion != kVersion) {
+      printf("TSamuraiFieldFile::Open() : unsupported version %u in %s\n",
+	     header.fVersion,filename);
+      return false;
+   }
+
+   fEntries.resize(header.fNMaps);
+   ifs.seekg(header.fTOCOffset,std::fstream::beg);
+   if (header.fNMaps
+       && !ifs.read((char*)&fEntries[0],sizeof(Entry) * header.fNMaps)) {
+      printf("TSamuraiFieldFile::Open() : broken table of contents in %s\n",
+	     filename);
+      fEntries.clear();
+      return false;
+   }
+
+   return true;
+}
+
+bool TSamuraiFieldFile::IsContainer(const char* filename)
+{
+   std::ifstream ifs(filename,std::ios::binary);
+   char magic[sizeof(kMagic)];
+   return ifs.read(magic,sizeof(magic))
+      && !memcmp(magic,kMagic,sizeof(kMagic));
+}
+
+int TSamuraiFieldFile::FindMap(const char* name) const
+{
+   if (fEntries.empty()) return -1;
+   if (!name || !*name) return 0;
+
+   for (size_t i = 0; i != fEntries.size(); ++i) {
+      if (!strncmp(fEntries[i].fName,name,kNameLength)) return i;
+   }
+   return -1;
+}
+
+bool TSamuraiFieldFile::Verify(int i) const
+{
+   const Entry &entry = fEntries[i];
+   std::ifstream ifs(fFileName.c_str(),std::ios::binary);
+   if (!ifs) return false;
+   ifs.seekg(entry.fOffset,std::fstream::beg);
+
+   std::vector<char> buf(1 << 20);
+   uint64_t sum = Checksum(NULL,0);
+   for (uint64_t left = entry.fSize; left; ) {
+      const size_t n = left < buf.size() ? left : buf.size();
+      if (!ifs.read(&buf[0],n)) return false;
+      sum = Checksum(&buf[0],n,sum);
+      left -= n;
+   }
+   return sum == entry.fChecksum;
+}
+
+bool TSamuraiFieldFile::Write(const char* filename, std::vector<Entry> entries,
+			      const std::vector<const void*> &data)
+{
+   if (entries.size() != data.size()) return false;
+
+   std::ofstream ofs(filename,std::ios::binary);
+   if (!ofs) {
+      printf("TSamuraiFieldFile::Write() : Cannot open file: %s\n",filename);
+      return false;
+   }
+
+   Header header;
+   memcpy(header.fMagic,kMagic,sizeof(kMagic));
+   header.fVersion   = kVersion;
+   header.fNMaps     = entries.size();
+   header.fTOCOffset = sizeof(Header);
+
+   uint64_t pos = Align(sizeof(Header) + sizeof(Entry) * entries.size());
+   for (size_t i = 0; i != entries.size(); ++i) {
+      entries[i].fOffset   = pos;
+      entries[i].fChecksum = Checksum(data[i],entries[i].fSize);
+      pos = Align(pos + entries[i].fSize);
+   }
+
+   ofs.write((const char*)&header,sizeof(header));
+   if (!entries.empty()) {
+      ofs.write((const char*)&entries[0],sizeof(Entry) * entries.size());
+   }
+   for (size_t i = 0; i != entries.size(); ++i) {
+      ofs.seekp(entries[i].fOffset,std::fstream::beg);
+      ofs.write((const char*)data[i],entries[i].fSize);
+   }
+
+   return ofs.good();
+}
+
+bool TSamuraiFieldFile::EncodeTiles(const float* data, const Entry &entry,
+				    int tile, std::vector<char> *payload)
+{
+   const int nx = entry.fNx, ny = entry.fNy, nz = entry.fNz;
+   TileHeader header;
+   header.fTile = tile;
+   header.fNTx  = (nx - 2) / tile + 1;
+   header.fNTy  = (ny - 2) / tile + 1;
+   header.fNTz  = (nz - 2) / tile + 1;
+   const size_t nTile = (size_t)header.fNTx * header.fNTy * header.fNTz;
+
+   std::vector<TileIndex> index(nTile);
+   std::vector<char> compressed;
+   std::vector<float> raw;
+   std::vector<unsigned char> shuffled;
+
+   for (int tx = 0; tx != header.fNTx; ++tx) {
+      for (int ty = 0; ty != header.fNTy; ++ty) {
+	 for (int tz = 0; tz != header.fNTz; ++tz) {
+	    const int ni = TileNodes(nx,tile,tx);
+	    const int nj = TileNodes(ny,tile,ty);
+	    const int nk = TileNodes(nz,tile,tz);
+	    raw.resize((size_t)ni * nj * nk * 3);
+	    float *p = &raw[0];
+	    for (int i = 0; i != ni; ++i) {
+	       for (int j = 0; j != nj; ++j) {
+		  const float *row = data
+		     + (((size_t)(tx * tile + i) * ny + ty * tile + j) * nz
+			+ tz * tile) * 3;
+		  p = std::copy(row,row + nk * 3,p);
+	       }
+	    }
+
+	    /* byte shuffle: group n-th bytes of all floats together */
+	    const size_t rawSize = raw.size() * sizeof(float);
+	    const unsigned char *bytes = (const unsigned char*)&raw[0];
+	    shuffled.resize(rawSize);
+	    for (size_t n = 0; n != raw.size(); ++n) {
+	       for (size_t b = 0; b != sizeof(float); ++b) {
+		  shuffled[b * raw.size() + n] = bytes[n * sizeof(float) + b];
+	       }
+	    }
+
+	    uLongf size = compressBound(rawSize);
+	    compressed.resize(size);
+	    if (compress2((Bytef*)&compressed[0],&size,
+			  &shuffled[0],rawSize,6) != Z_OK) {
+	       return false;
+	    }
+
+	    TileIndex &idx = index[((size_t)tx * header.fNTy + ty) * header.fNTz + tz];
+	    idx.fOffset  = payload->size();
+	    idx.fSize    = size;
+	    idx.fRawSize = rawSize;
+	    payload->insert(payload->end(),compressed.begin(),
+			    compressed.begin() + size);
+	 }
+      }
+   }
+
+   /* prepend header and index, shifting tile offsets accordingly */
+   const size_t head = sizeof(header) + sizeof(TileIndex) * nTile;
+   for (size_t t = 0; t != nTile; ++t) index[t].fOffset += head;
+   payload->insert(payload->begin(),(const char*)&index[0],
+		   (const char*)&index[0] + sizeof(TileIndex) * nTile);
+   payload->insert(payload->begin(),(const char*)&header,
+		   (const char*)&header + sizeof(header));
+   return true;
+}
+
+bool TSamuraiFieldFile::DecodeTile(const char* src, size_t size,
+				   float* out, size_t rawSize)
+{
+   std::vector<unsigned char> shuffled(rawSize);
+   uLongf outSize = rawSize;
+   if (uncompress(&shuffled[0],&outSize,(const Bytef*)src,size) != Z_OK
+       || outSize != rawSize) {
+      return false;
+   }
+
+   const size_t n = rawSize / sizeof(float);
+   unsigned char *bytes = (unsigned char*)out;
+   for (size_t i = 0; i != n; ++i) {
+      for (size_t b = 0; b != sizeof(float); ++b) {
+	 bytes[i * sizeof(float) + b] = shuffled[b * n + i];
+      }
+   }
+   return true;
+}
+
+uint64_t TSamuraiFieldFile::Checksum(const void* data, size_t size,
+				     uint64_t seed)
+{
+   const unsigned char *p = static_cast<const unsigned char*>(data);
+   uint64_t hash = seed;
+   for (size_t i = 0; i != size; ++i) {
+      hash ^= p[i];
+      hash *= 1099511628211ULL;
+   }
+   return hash;
+}
+
+void TSamuraiFieldFile::SetLegacyGeometry(Entry *entry,
+					  int nx, int ny, int nz,
+					  double dx, double dy, double dz)
+{
+   entry->fNx    = nx;
+   entry->fNy    = ny;
+   entry->fNz    = nz;
+   entry->fDx    = dx;
+   entry->fDy    = dy;
+   entry->fDz    = dz;
+   entry->fX0    = 0.;
+   entry->fY0    = - (ny / 2) * dy;
+   entry->fZ0    = 0.;
+   entry->fFlags = kMirrorX | kMirrorZ;
+   entry->fSize  = sizeof(float) * 3 * (uint64_t)nx * ny * nz;
+}
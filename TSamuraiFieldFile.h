@@ -0,0 +1,128 @@
+/**
+ * @file   TSamuraiFieldFile.h
+ * @brief  Indexed container for SAMURAI magnet field maps
+ *
+ * @date   Created       : 2026-10-17 10:12:31 JST
+ *         Last Modified : 2026-10-17 10:12:31 JST (kawase)
+ * @author KAWASE Shoichiro <kawase@aees.kyushu-u.ac.jp>
+ *
+ *    (C) 2016 KAWASE Shoichiro
+ */
+
+#ifndef INCLUDE_GUARD_UUID_0B0C3E1F_6A29_4C1E_9C57_3F1B8D2A7E64
+#define INCLUDE_GUARD_UUID_0B0C3E1F_6A29_4C1E_9C57_3F1B8D2A7E64
+
+#include <stdint.h>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace art {
+   class TSamuraiFieldFile;
+}
+
+////////////////////////////////////////////////////////////
+///
+/// File layout (little endian)
+///
+///   Header   : magic "SAMFIELD", version, number of maps, TOC offset
+///   TOC      : one Entry per map (fixed size)
+///   Payloads : each map's float array [nx][ny][nz][3], page aligned
+///
+/// A payload flagged kTiled instead holds the map split into tiles of
+/// tile^3 cells (tile+1 nodes per side, so that every cell lies in one
+/// tile), each byte-shuffled and zlib compressed:
+///
+///   TileHeader, TileIndex[ntx*nty*ntz], compressed tiles
+///
+/// Only the header and the TOC are read on Open(), so selecting a map
+/// costs the same regardless of how many maps the file holds. The map
+/// itself is then mapped (or read) directly from Entry::fOffset.
+///
+
+class art::TSamuraiFieldFile {
+public:
+   enum { kNameLength = 32 };
+   enum ESymmetry {
+      kMirrorX = 1 << 0, // B(x,y,z) = B(|x|,y,z)
+      kMirrorZ = 1 << 1, // B(x,y,z) = B(x,y,|z|)
+      kTiled   = 1 << 8  // payload is a compressed tile set
+   };
+
+   struct Entry {
+      char     fName[kNameLength];
+      int32_t  fNx, fNy, fNz;
+      uint32_t fFlags;        // ESymmetry
+      double   fDx, fDy, fDz; // mesh size (mm)
+      double   fX0, fY0, fZ0; // position of node (0,0,0) (mm)
+      double   fCurrent;      // nominal excitation current (A)
+      double   fCentralField; // By at the magnet center (T)
+      uint64_t fOffset;       // payload offset from file head
+      uint64_t fSize;         // payload size in bytes
+      uint64_t fChecksum;     // FNV-1a 64 of the payload
+   };
+
+   struct TileHeader {
+      int32_t  fTile;         // cells per tile side
+      int32_t  fNTx, fNTy, fNTz;
+   };
+
+   struct TileIndex {
+      uint64_t fOffset;       // from payload head
+      uint32_t fSize;         // compressed size
+      uint32_t fRawSize;      // decompressed size
+   };
+
+   static const char     kMagic[8];
+   static const uint32_t kVersion = 1;
+
+   TSamuraiFieldFile();
+
+   // read header and TOC. returns false if filename is not a container.
+   bool Open(const char* filename);
+   static bool IsContainer(const char* filename);
+
+   int GetNMaps() const {return fEntries.size();}
+   const Entry& GetEntry(int i) const {return fEntries[i];}
+   // returns index of the map named name (first map if name is empty)
+   int FindMap(const char* name) const;
+
+   // compute checksum of the payload of i-th map and compare with TOC
+   bool Verify(int i) const;
+
+   // write maps into a new container. data[i] points fEntries[i].fSize
+   // bytes; offsets, sizes and checksums are filled in.
+   static bool Write(const char* filename, std::vector<Entry> entries,
+		     const std::vector<const void*> &data);
+
+   // split a [nx][ny][nz][3] map into a compressed tile set payload
+   static bool EncodeTiles(const float* data, const Entry &entry, int tile,
+			   std::vector<char> *payload);
+   // decompress one tile of rawSize bytes into out
+   static bool DecodeTile(const char* src, size_t size,
+			  float* out, size_t rawSize);
+   // number of nodes of tile t along an axis with n nodes
+   static int TileNodes(int n, int tile, int t)
+   { return (n - 1 - t * tile < tile ? n - 1 - t * tile : tile) + 1; }
+
+   static uint64_t Checksum(const void* data, size_t size,
+			    uint64_t seed = 14695981039346656037ULL);
+
+   // fill entry with the legacy raw map geometry (301x81x301 @ 10 mm)
+   static void SetLegacyGeometry(Entry *entry,
+				 int nx = 301, int ny = 81, int nz = 301,
+				 double dx = 10, double dy = 10, double dz = 10);
+
+private:
+   struct Header {
+      char     fMagic[8];
+      uint32_t fVersion;
+      uint32_t fNMaps;
+      uint64_t fTOCOffset;
+   };
+
+   std::string        fFileName;
+   std::vector<Entry> fEntries;
+};
+
+#endif // INCLUDE_GUARD_UUID_0B0C3E1F_6A29_4C1E_9C57_3F1B8D2A7E64
@@ -0,0 +1,75 @@
+/**
+ * @file   TSamuraiFieldGrid.h
+ * @brief  field lookup on a grid fixed at compile time
+ *
+ * @date   Created       : 2026-10-17 17:08:44 JST
+ *         Last Modified : 2026-10-17 17:08:44 JST (kawase)
+ * @author KAWASE Shoichiro <kawase@aees.kyushu-u.ac.jp>
+ *
+ *    (C) 2016 KAWASE Shoichiro
+ */
+
+#ifndef INCLUDE_GUARD_UUID_4A7E2C91_5F3B_4D08_B6A1_E82D9C0F7346
+#define INCLUDE_GUARD_UUID_4A7E2C91_5F3B_4D08_B6A1_E82D9C0F7346
+
+#include <cmath>
+#include <cstddef>
+
+namespace art {
+   template <int NX, int NY, int NZ, int DX, int DY, int DZ>
+   struct TSamuraiFieldGrid;
+}
+
+////////////////////////////////////////////////////////////
+///
+/// Trilinear lookup in a node-major [NX][NY][NZ][3] map with mesh
+/// DX, DY, DZ (mm) in the legacy geometry: mirrored in x and z, node
+/// (0,0,0) at (0, -(NY/2)*DY, 0). With the grid known at compile time
+/// the cell search needs no division (the mesh becomes a constant
+/// multiply) and all corner offsets are immediates.
+///
+/// Eval() stores the unscaled field in b and returns false outside the
+/// grid. TSamuraiMagnetField dispatches to an instantiation matching
+/// its geometry and falls back to the generic path otherwise.
+///
+
+template <int NX, int NY, int NZ, int DX, int DY, int DZ>
+struct art::TSamuraiFieldGrid {
+   static const size_t kStrideY = (size_t)NZ * 3;
+   static const size_t kStrideX = (size_t)NY * NZ * 3;
+
+   static bool Eval(const float *data, double x, double y, double z,
+		    double *b)
+   {
+      const double u = fabs(x) * (1. / DX);
+      const double v = y * (1. / DY) + NY / 2;
+      const double w = fabs(z) * (1. / DZ);
+      /* negated so that NaN is rejected as well */
+      if (!(u < NX - 1) || !(0. <= v && v < NY - 1) || !(w < NZ - 1)) {
+	 return false;
+      }
+      const int i = (int)u; // non-negative: truncation is floor
+      const int j = (int)v;
+      const int k = (int)w;
+      const double p = u - i;
+      const double q = v - j;
+      const double r = w - k;
+
+      const float *const f = data + i * kStrideX + j * kStrideY + k * 3;
+      for (int axis = 0; axis != 3; ++axis) {
+	 const float *const c = f + axis;
+	 const double c00 = (1-p)*c[0]          + p*c[kStrideX];
+	 const double c01 = (1-p)*c[3]          + p*c[kStrideX+3];
+	 const double c10 = (1-p)*c[kStrideY]   + p*c[kStrideX+kStrideY];
+	 const double c11 = (1-p)*c[kStrideY+3] + p*c[kStrideX+kStrideY+3];
+
+	 const double c0 = (1-q)*c00 + q*c10;
+	 const double c1 = (1-q)*c01 + q*c11;
+
+	 b[axis] = (1-r)*c0 + r*c1;
+      }
+      return true;
+   }
+};
+
+#endif // INCLUDE_GUARD_UUID_4A7E2C91_5F3B_4D08_B6A1_E82D9C0F7346
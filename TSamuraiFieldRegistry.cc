@@ -0,0 +1,287 @@
+/**
+ * @file   TSamuraiFieldRegistry.cc
+ * @brief  field maps shared between processes through POSIX shared memory
+ *
+ * @date   Created       : 2026-10-17 14:41:52 JST
+ *         Last Modified : 2026-10-17 14:41:52 JST (kawase)
+ * @author KAWASE Shoichiro <kawase@aees.kyushu-u.ac.jp>
+ *
+ *    (C) 2016 KAWASE Shoichiro
+ */
+
+#include "TSamuraiFieldRegistry.h"
+#include "TSamuraiFieldFile.h"
+
+#include <cerrno>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+using art::TSamuraiFieldRegistry;
+
+namespace {
+   const char     kPrefix[]     = "samfield-";
+   const uint32_t kHeaderMagic  = 0x53464d52; // "SFMR"
+   const size_t   kHeaderSize   = 4096;
+   const int      kMaxUsers     = 256;
+   const int      kWaitTimeout  = 600;        // s, to publish a segment
+
+   enum { kFilling = 0, kReady = 1, kBroken = 2 };
+
+   inline bool IsAlive(int pid)
+   {
+      return !kill(pid,0) || errno != ESRCH;
+   }
+}
+
+struct TSamuraiFieldRegistry::Header {
+   uint32_t fMagic;
+   volatile int32_t fState;
+   int32_t  fCreator;
+   uint64_t fSize;
+   volatile int32_t fUsers[kMaxUsers]; // pids, 0 = free
+};
+
+TSamuraiFieldRegistry::TSamuraiFieldRegistry()
+   : fName(""), fHeader(NULL), fData(NULL), fSize(0), fSlot(-1),
+     fCreator(false)
+{
+}
+
+TSamuraiFieldRegistry::~TSamuraiFieldRegistry()
+{
+   Detach();
+}
+
+std::string TSamuraiFieldRegistry::MakeKey(const char* filename,
+					   const char* mapName,
+					   uint64_t checksum,
+					   const char* layout)
+{
+   char path[PATH_MAX];
+   if (!realpath(filename,path)) {
+      strncpy(path,filename,sizeof(path) - 1);
+      path[sizeof(path) - 1] = '\0';
+   }
+
+   /* raw maps carry no checksum: identify them by inode and mtime */
+   struct stat st;
+   uint64_t id = checksum;
+   if (!id && !stat(path,&st)) {
+      id = ((uint64_t)st.st_ino << 32) ^ st.st_size ^ st.st_mtime;
+   }
+
+   uint64_t hash = TSamuraiFieldFile::Checksum(path,strlen(path));
+   if (mapName) hash = TSamuraiFieldFile::Checksum(mapName,strlen(mapName),hash);
+   hash = TSamuraiFieldFile::Checksum(&id,sizeof(id),hash);
+   hash = TSamuraiFieldFile::Checksum(layout,strlen(layout),hash);
+
+   char name[64];
+   snprintf(name,sizeof(name),"/%s%016llx-%s",kPrefix,
+	    (unsigned long long)hash,layout);
+   return name;
+}
+
+TSamuraiFieldRegistry::EState
+TSamuraiFieldRegistry::Attach(const std::string &key, size_t size)
+{
+   Detach();
+   fName = key;
+   fSize = size;
+
+   for (int attempt = 0; attempt != 3; ++attempt) {
+      int fd = shm_open(fName.c_str(),O_RDWR | O_CREAT | O_EXCL,0644);
+      if (fd >= 0) { /* we are the creator */
+	 void *p = MAP_FAILED;
+	 if (!ftruncate(fd,kHeaderSize + size)) {
+	    p = mmap(NULL,kHeaderSize + size,PROT_READ | PROT_WRITE,
+		     MAP_SHARED,fd,0);
+	 }
+	 close(fd);
+	 if (p == MAP_FAILED) {
+	    shm_unlink(fName.c_str());
+	    return kFailed;
+	 }
+	 fHeader = static_cast<Header*>(p);
+	 fData   = static_cast<char*>(p) + kHeaderSize;
+	 fHeader->fCreator = getpid();
+	 fHeader->fSize    = size;
+	 fHeader->fState   = kFilling;
+	 __sync_synchronize();
+	 fHeader->fMagic   = kHeaderMagic;
+	 fCreator = true;
+	 ClaimSlot();
+	 return kCreated;
+      }
+      if (errno != EEXIST) return kFailed;
+
+      fd = shm_open(fName.c_str(),O_RDWR,0);
+      if (fd < 0) continue; // removed in the meantime
+
+      /* wait for the creator to size and publish the segment */
+      bool stale = false;
+      struct stat st;
+      Header *header = NULL;
+      for (int ms = 0; ; ++ms) {
+	 if (!header && !fstat(fd,&st)
+	     && (size_t)st.st_size == kHeaderSize + size) {
+	    void *p = mmap(NULL,kHeaderSize,PROT_READ | PROT_WRITE,
+			   MAP_SHARED,fd,0);
+	    if (p != MAP_FAILED) header = static_cast<Header*>(p);
+	 }
+	 if (header && header->fMagic == kHeaderMagic) {
+	    if (header->fState == kReady) break;
+	    if (header->fState == kBroken || !IsAlive(header->fCreator)) {
+	       stale = true;
+	       break;
+	    }
+	 }
+	 if ((!header && ms > 1000) || ms > kWaitTimeout * 1000) {
+	    stale = true;
+	    break;
+	 }
+	 usleep(1000);
+      }
+
+      if (stale || header->fSize != size) {
+	 printf("TSamuraiFieldRegistry::Attach() : removing stale segment %s\n",
+		fName.c_str());
+	 if (header) munmap(header,kHeaderSize);
+	 close(fd);
+	 shm_unlink(fName.c_str());
+	 continue;
+      }
+
+      void *p = mmap(NULL,kHeaderSize + size,PROT_READ,MAP_SHARED,fd,0);
+      close(fd);
+      munmap(header,kHeaderSize);
+      if (p == MAP_FAILED) return kFailed;
+      /* remap the header writable for user bookkeeping */
+      fHeader = static_cast<Header*>(p);
+      if (mprotect(p,kHeaderSize,PROT_READ | PROT_WRITE)) {
+	 munmap(p,kHeaderSize + size);
+	 fHeader = NULL;
+	 return kFailed;
+      }
+      fData = static_cast<char*>(p) + kHeaderSize;
+      if (!ClaimSlot()) {
+	 munmap(p,kHeaderSize + size);
+	 fHeader = NULL;
+	 fData = NULL;
+	 return kFailed;
+      }
+      return kAttached;
+   }
+
+   return kFailed;
+}
+
+bool TSamuraiFieldRegistry::ClaimSlot()
+{
+   const int pid = getpid();
+   for (int pass = 0; pass != 2; ++pass) {
+      for (int i = 0; i != kMaxUsers; ++i) {
+	 if (__sync_bool_compare_and_swap(&fHeader->fUsers[i],0,pid)) {
+	    fSlot = i;
+	    return true;
+	 }
+      }
+      CountUsers(fHeader); // reclaim slots of dead processes and retry
+   }
+   printf("TSamuraiFieldRegistry::Attach() : too many users of %s\n",
+	  fName.c_str());
+   return false;
+}
+
+int TSamuraiFieldRegistry::CountUsers(Header *header)
+{
+   int n = 0;
+   for (int i = 0; i != kMaxUsers; ++i) {
+      const int pid = header->fUsers[i];
+      if (!pid) continue;
+      if (IsAlive(pid)) {
+	 ++n;
+      } else {
+	 __sync_bool_compare_and_swap(&header->fUsers[i],pid,0);
+      }
+   }
+   return n;
+}
+
+bool TSamuraiFieldRegistry::Publish()
+{
+   if (!fCreator || !fHeader) return false;
+   __sync_synchronize();
+   fHeader->fState = kReady;
+   mprotect(fData,fSize,PROT_READ);
+   return true;
+}
+
+void TSamuraiFieldRegistry::Abandon()
+{
+   if (!fCreator || !fHeader) return;
+   fHeader->fState = kBroken;
+   shm_unlink(fName.c_str());
+   Detach();
+}
+
+void TSamuraiFieldRegistry::Detach()
+{
+   if (!fHeader) return;
+
+   if (fSlot >= 0) {
+      fHeader->fUsers[fSlot] = 0;
+      __sync_synchronize();
+      fSlot = -1;
+   }
+   if (!CountUsers(fHeader)) {
+      shm_unlink(fName.c_str());
+   }
+
+   munmap(fHeader,kHeaderSize + fSize);
+   fHeader  = NULL;
+   fData    = NULL;
+   fCreator = false;
+}
+
+int TSamuraiFieldRegistry::CleanupStale()
+{
+   DIR *dir = opendir("/dev/shm");
+   if (!dir) return 0;
+
+   int nRemoved = 0;
+   while (struct dirent *ent = readdir(dir)) {
+      if (strncmp(ent->d_name,kPrefix,sizeof(kPrefix) - 1)) continue;
+
+      const std::string name = std::string("/") + ent->d_name;
+      const int fd = shm_open(name.c_str(),O_RDWR,0);
+      if (fd < 0) continue;
+
+      struct stat st;
+      void *p = MAP_FAILED;
+      if (!fstat(fd,&st) && (size_t)st.st_size >= kHeaderSize) {
+	 p = mmap(NULL,kHeaderSize,PROT_READ | PROT_WRITE,MAP_SHARED,fd,0);
+      }
+      close(fd);
+      if (p == MAP_FAILED) continue;
+
+      Header *header = static_cast<Header*>(p);
+      const bool filling = header->fMagic == kHeaderMagic
+	 && header->fState == kFilling && IsAlive(header->fCreator);
+      if (!filling && !CountUsers(header)) {
+	 shm_unlink(name.c_str());
+	 ++nRemoved;
+      }
+      munmap(p,kHeaderSize);
+   }
+   closedir(dir);
+   return nRemoved;
+}
@@ -0,0 +1,74 @@
+/**
+ * @file   TSamuraiFieldRegistry.h
+ * @brief  field maps shared between processes through POSIX shared memory
+ *
+ * @date   Created       : 2026-10-17 14:41:52 JST
+ *         Last Modified : 2026-10-17 14:41:52 JST (kawase)
+ * @author KAWASE Shoichiro <kawase@aees.kyushu-u.ac.jp>
+ *
+ *    (C) 2016 KAWASE Shoichiro
+ */
+
+#ifndef INCLUDE_GUARD_UUID_C3A91E57_2D84_4B6F_8E10_5A7D3F92B0C4
+#define INCLUDE_GUARD_UUID_C3A91E57_2D84_4B6F_8E10_5A7D3F92B0C4
+
+#include <stdint.h>
+#include <cstddef>
+#include <string>
+
+namespace art {
+   class TSamuraiFieldRegistry;
+}
+
+////////////////////////////////////////////////////////////
+///
+/// One attachment to a named shared memory segment holding a field
+/// array. The segment name is derived from the map file, its checksum
+/// and the memory layout (MakeKey()), so every process asking for the
+/// same map in the same layout gets the same segment.
+///
+/// The first process creates the segment (Attach() == kCreated), fills
+/// GetData() and calls Publish(); later processes wait for it to be
+/// published and map the data read-only (kAttached). Users are counted
+/// by pid in the segment header: the last one to Detach() unlinks the
+/// segment, slots of dead processes are reclaimed, and a segment whose
+/// creator died before publishing is removed and rebuilt.
+///
+
+class art::TSamuraiFieldRegistry {
+public:
+   enum EState { kFailed, kCreated, kAttached };
+
+   TSamuraiFieldRegistry();
+   ~TSamuraiFieldRegistry();
+
+   EState Attach(const std::string &key, size_t size);
+   void* GetData() const {return fData;}
+   bool Publish();    // creator: data is complete, make it read-only
+   void Abandon();    // creator: filling failed, remove the segment
+   void Detach();
+
+   // segment name for a map identified by file, checksum and layout
+   static std::string MakeKey(const char* filename, const char* mapName,
+			      uint64_t checksum, const char* layout);
+   // unlink segments of this registry without live users
+   static int CleanupStale();
+
+private:
+   struct Header;
+
+   std::string fName;
+   Header *fHeader;
+   void   *fData;
+   size_t  fSize;
+   int     fSlot;
+   bool    fCreator;
+
+   bool ClaimSlot();
+   static int CountUsers(Header *header);
+
+   TSamuraiFieldRegistry(const TSamuraiFieldRegistry&);            // undefined
+   TSamuraiFieldRegistry& operator=(const TSamuraiFieldRegistry&); // undefined
+};
+
+#endif // INCLUDE_GUARD_UUID_C3A91E57_2D84_4B6F_8E10_5A7D3F92B0C4
@@ -0,0 +1,397 @@
+/**
+ * @file   TSamuraiFieldSimd.cc
+ * @brief  vectorized field lookup for batches of points
+ *
+ * @date   Created       : 2026-10-17 17:52:30 JST
+ *         Last Modified : 2026-10-17 17:52:30 JST (kawase)
+ * @author KAWASE Shoichiro <kawase@aees.kyushu-u.ac.jp>
+ *
+ *    (C) 2016 KAWASE Shoichiro
+ */
+
+#include "TSamuraiFieldSimd.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SAMURAI_FIELD_SIMD
+#endif
+
+/* AVX-512 implies FMA: keep a*b + c rounded twice as in the scalar code */
+#pragma GCC optimize ("fp-contract=off")
+
+using art::TSamuraiFieldSimd;
+
+#ifdef SAMURAI_FIELD_SIMD
+
+bool TSamuraiFieldSimd::HasAVX2()
+{
+   return __builtin_cpu_supports("avx2");
+}
+
+bool TSamuraiFieldSimd::HasAVX512()
+{
+   return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx2");
+}
+
+/* corner n = (di << 2) | (dj << 1) | dk, as in TSamuraiMagnetField */
+#define CORNER_OFFSETS(g)					\
+   { 0, 3, (int)(g).fStrideY, (int)(g).fStrideY + 3,		\
+     (int)(g).fStrideX, (int)(g).fStrideX + 3,			\
+     (int)((g).fStrideX + (g).fStrideY),			\
+     (int)((g).fStrideX + (g).fStrideY) + 3 }
+
+__attribute__((target("avx2")))
+size_t TSamuraiFieldSimd::EvalAVX2(const Grid &g, size_t n,
+				   const double x[], const double y[],
+				   const double z[],
+				   double bx[], double by[], double bz[])
+{
+   const __m256d absMask = _mm256_castsi256_pd(_mm256_set1_epi64x(0x7fffffffffffffffLL));
+   const __m256d zero  = _mm256_setzero_pd();
+   const __m256d one   = _mm256_set1_pd(1.);
+   const __m256d scale = _mm256_set1_pd(g.fScale);
+   const __m256d dx = _mm256_set1_pd(g.fDx);
+   const __m256d dy = _mm256_set1_pd(g.fDy);
+   const __m256d dz = _mm256_set1_pd(g.fDz);
+   const __m256d x0 = _mm256_set1_pd(g.fX0);
+   const __m256d y0 = _mm256_set1_pd(g.fY0);
+   const __m256d z0 = _mm256_set1_pd(g.fZ0);
+   const __m256d imax = _mm256_set1_pd(g.fNx - 1);
+   const __m256d jmax = _mm256_set1_pd(g.fNy - 1);
+   const __m256d kmax = _mm256_set1_pd(g.fNz - 1);
+   const __m256d strideX = _mm256_set1_pd((double)g.fStrideX);
+   const __m256d strideY = _mm256_set1_pd((double)g.fStrideY);
+   const __m256d three   = _mm256_set1_pd(3.);
+   const int offsets[8] = CORNER_OFFSETS(g);
+   __m128i corner[8];
+   for (int c = 0; c != 8; ++c) corner[c] = _mm_set1_epi32(offsets[c]);
+
+   double *const b[3] = { bx, by, bz };
+   size_t i = 0;
+   for (; i + 4 <= n; i += 4) {
+      __m256d vx = _mm256_loadu_pd(x + i);
+      __m256d vz = _mm256_loadu_pd(z + i);
+      if (g.fMirrorX) vx = _mm256_and_pd(vx,absMask);
+      if (g.fMirrorZ) vz = _mm256_and_pd(vz,absMask);
+      const __m256d sx = _mm256_sub_pd(vx,x0);
+      const __m256d sy = _mm256_sub_pd(_mm256_loadu_pd(y + i),y0);
+      const __m256d sz = _mm256_sub_pd(vz,z0);
+
+      /* DivRem */
+      const __m256d fi = _mm256_floor_pd(_mm256_div_pd(sx,dx));
+      const __m256d fj = _mm256_floor_pd(_mm256_div_pd(sy,dy));
+      const __m256d fk = _mm256_floor_pd(_mm256_div_pd(sz,dz));
+      const __m256d p = _mm256_div_pd(_mm256_sub_pd(sx,_mm256_mul_pd(fi,dx)),dx);
+      const __m256d q = _mm256_div_pd(_mm256_sub_pd(sy,_mm256_mul_pd(fj,dy)),dy);
+      const __m256d r = _mm256_div_pd(_mm256_sub_pd(sz,_mm256_mul_pd(fk,dz)),dz);
+
+      /* boundary check (false for NaN) */
+      const __m256d inside =
+	 _mm256_and_pd(_mm256_and_pd(_mm256_and_pd(_mm256_cmp_pd(fi,zero,_CMP_GE_OQ),
+						   _mm256_cmp_pd(fi,imax,_CMP_LT_OQ)),
+				     _mm256_and_pd(_mm256_cmp_pd(fj,zero,_CMP_GE_OQ),
+						   _mm256_cmp_pd(fj,jmax,_CMP_LT_OQ))),
+		       _mm256_and_pd(_mm256_cmp_pd(fk,zero,_CMP_GE_OQ),
+				     _mm256_cmp_pd(fk,kmax,_CMP_LT_OQ)));
+      const __m256d node =
+	 _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(fi,strideX),_mm256_mul_pd(fj,strideY)),
+		       _mm256_mul_pd(fk,three));
+      const __m128i index = _mm256_cvttpd_epi32(_mm256_and_pd(node,inside));
+
+      const __m256d p1 = _mm256_sub_pd(one,p);
+      const __m256d q1 = _mm256_sub_pd(one,q);
+      const __m256d r1 = _mm256_sub_pd(one,r);
+      for (int axis = 0; axis != 3; ++axis) {
+	 const float *const data = g.fData + axis;
+	 __m256d f[8];
+	 for (int c = 0; c != 8; ++c) {
+	    f[c] = _mm256_cvtps_pd(_mm_i32gather_ps(data,_mm_add_epi32(index,corner[c]),4));
+	 }
+	 /* trilinear interpolation */
+	 const __m256d c00 = _mm256_add_pd(_mm256_mul_pd(p1,f[0]),_mm256_mul_pd(p,f[4]));
+	 const __m256d c01 = _mm256_add_pd(_mm256_mul_pd(p1,f[1]),_mm256_mul_pd(p,f[5]));
+	 const __m256d c10 = _mm256_add_pd(_mm256_mul_pd(p1,f[2]),_mm256_mul_pd(p,f[6]));
+	 const __m256d c11 = _mm256_add_pd(_mm256_mul_pd(p1,f[3]),_mm256_mul_pd(p,f[7]));
+	 const __m256d c0 = _mm256_add_pd(_mm256_mul_pd(q1,c00),_mm256_mul_pd(q,c10));
+	 const __m256d c1 = _mm256_add_pd(_mm256_mul_pd(q1,c01),_mm256_mul_pd(q,c11));
+	 const __m256d c = _mm256_add_pd(_mm256_mul_pd(r1,c0),_mm256_mul_pd(r,c1));
+	 _mm256_storeu_pd(b[axis] + i,_mm256_and_pd(_mm256_mul_pd(scale,c),inside));
+      }
+   }
+   return i;
+}
+
+__attribute__((target("avx512f,avx2")))
+size_t TSamuraiFieldSimd::EvalAVX512(const Grid &g, size_t n,
+				     const double x[], const double y[],
+				     const double z[],
+				     double bx[], double by[], double bz[])
+{
+   const __m512d zero  = _mm512_setzero_pd();
+   const __m512d one   = _mm512_set1_pd(1.);
+   const __m512d scale = _mm512_set1_pd(g.fScale);
+   const __m512d dx = _mm512_set1_pd(g.fDx);
+   const __m512d dy = _mm512_set1_pd(g.fDy);
+   const __m512d dz = _mm512_set1_pd(g.fDz);
+   const __m512d x0 = _mm512_set1_pd(g.fX0);
+   const __m512d y0 = _mm512_set1_pd(g.fY0);
+   const __m512d z0 = _mm512_set1_pd(g.fZ0);
+   const __m512d imax = _mm512_set1_pd(g.fNx - 1);
+   const __m512d jmax = _mm512_set1_pd(g.fNy - 1);
+   const __m512d kmax = _mm512_set1_pd(g.fNz - 1);
+   const __m512d strideX = _mm512_set1_pd((double)g.fStrideX);
+   const __m512d strideY = _mm512_set1_pd((double)g.fStrideY);
+   const __m512d three   = _mm512_set1_pd(3.);
+   const int offsets[8] = CORNER_OFFSETS(g);
+   __m256i corner[8];
+   for (int c = 0; c != 8; ++c) corner[c] = _mm256_set1_epi32(offsets[c]);
+
+   double *const b[3] = { bx, by, bz };
+   size_t i = 0;
+   for (; i + 8 <= n; i += 8) {
+      __m512d vx = _mm512_loadu_pd(x + i);
+      __m512d vz = _mm512_loadu_pd(z + i);
+      if (g.fMirrorX) vx = _mm512_abs_pd(vx);
+      if (g.fMirrorZ) vz = _mm512_abs_pd(vz);
+      const __m512d sx = _mm512_sub_pd(vx,x0);
+      const __m512d sy = _mm512_sub_pd(_mm512_loadu_pd(y + i),y0);
+      const __m512d sz = _mm512_sub_pd(vz,z0);
+
+      /* DivRem */
+      const int down = _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC;
+      const __m512d fi = _mm512_maskz_roundscale_pd(0xff,_mm512_div_pd(sx,dx),down);
+      const __m512d fj = _mm512_maskz_roundscale_pd(0xff,_mm512_div_pd(sy,dy),down);
+      const __m512d fk = _mm512_maskz_roundscale_pd(0xff,_mm512_div_pd(sz,dz),down);
+      const __m512d p = _mm512_div_pd(_mm512_sub_pd(sx,_mm512_mul_pd(fi,dx)),dx);
+      const __m512d q = _mm512_div_pd(_mm512_sub_pd(sy,_mm512_mul_pd(fj,dy)),dy);
+      const __m512d r = _mm512_div_pd(_mm512_sub_pd(sz,_mm512_mul_pd(fk,dz)),dz);
+
+      /* boundary check (false for NaN) */
+      const __mmask8 inside =
+	 _mm512_cmp_pd_mask(fi,zero,_CMP_GE_OQ) & _mm512_cmp_pd_mask(fi,imax,_CMP_LT_OQ)
+	 & _mm512_cmp_pd_mask(fj,zero,_CMP_GE_OQ) & _mm512_cmp_pd_mask(fj,jmax,_CMP_LT_OQ)
+	 & _mm512_cmp_pd_mask(fk,zero,_CMP_GE_OQ) & _mm512_cmp_pd_mask(fk,kmax,_CMP_LT_OQ);
+      const __m512d node =
+	 _mm512_add_pd(_mm512_add_pd(_mm512_mul_pd(fi,strideX),_mm512_mul_pd(fj,strideY)),
+		       _mm512_mul_pd(fk,three));
+      const __m256i index = _mm512_maskz_cvttpd_epi32(inside,node);
+
+      const __m512d p1 = _mm512_sub_pd(one,p);
+      const __m512d q1 = _mm512_sub_pd(one,q);
+      const __m512d r1 = _mm512_sub_pd(one,r);
+      for (int axis = 0; axis != 3; ++axis) {
+	 const float *const data = g.fData + axis;
+	 __m512d f[8];
+	 for (int c = 0; c != 8; ++c) {
+	    f[c] = _mm512_maskz_cvtps_pd(0xff,_mm256_i32gather_ps(data,_mm256_add_epi32(index,corner[c]),4));
+	 }
+	 /* trilinear interpolation */
+	 const __m512d c00 = _mm512_add_pd(_mm512_mul_pd(p1,f[0]),_mm512_mul_pd(p,f[4]));
+	 const __m512d c01 = _mm512_add_pd(_mm512_mul_pd(p1,f[1]),_mm512_mul_pd(p,f[5]));
+	 const __m512d c10 = _mm512_add_pd(_mm512_mul_pd(p1,f[2]),_mm512_mul_pd(p,f[6]));
+	 const __m512d c11 = _mm512_add_pd(_mm512_mul_pd(p1,f[3]),_mm512_mul_pd(p,f[7]));
+	 const __m512d c0 = _mm512_add_pd(_mm512_mul_pd(q1,c00),_mm512_mul_pd(q,c10));
+	 const __m512d c1 = _mm512_add_pd(_mm512_mul_pd(q1,c01),_mm512_mul_pd(q,c11));
+	 const __m512d c = _mm512_add_pd(_mm512_mul_pd(r1,c0),_mm512_mul_pd(r,c1));
+	 _mm512_storeu_pd(b[axis] + i,_mm512_maskz_mov_pd(inside,_mm512_mul_pd(scale,c)));
+      }
+   }
+   return i;
+}
+
+__attribute__((target("avx2")))
+size_t TSamuraiFieldSimd::EvalAVX2(const Grid &g, size_t n,
+				   const float x[], const float y[],
+				   const float z[],
+				   float bx[], float by[], float bz[])
+{
+   const __m256 absMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+   const __m256 zero  = _mm256_setzero_ps();
+   const __m256 one   = _mm256_set1_ps(1.f);
+   const __m256 scale = _mm256_set1_ps((float)g.fScale);
+   const __m256 dx = _mm256_set1_ps((float)g.fDx);
+   const __m256 dy = _mm256_set1_ps((float)g.fDy);
+   const __m256 dz = _mm256_set1_ps((float)g.fDz);
+   const __m256 x0 = _mm256_set1_ps((float)g.fX0);
+   const __m256 y0 = _mm256_set1_ps((float)g.fY0);
+   const __m256 z0 = _mm256_set1_ps((float)g.fZ0);
+   const __m256 imax = _mm256_set1_ps((float)(g.fNx - 1));
+   const __m256 jmax = _mm256_set1_ps((float)(g.fNy - 1));
+   const __m256 kmax = _mm256_set1_ps((float)(g.fNz - 1));
+   const __m256i strideX = _mm256_set1_epi32((int)g.fStrideX);
+   const __m256i strideY = _mm256_set1_epi32((int)g.fStrideY);
+   const __m256i three   = _mm256_set1_epi32(3);
+   const int offsets[8] = CORNER_OFFSETS(g);
+   __m256i corner[8];
+   for (int c = 0; c != 8; ++c) corner[c] = _mm256_set1_epi32(offsets[c]);
+
+   float *const b[3] = { bx, by, bz };
+   size_t i = 0;
+   for (; i + 8 <= n; i += 8) {
+      __m256 vx = _mm256_loadu_ps(x + i);
+      __m256 vz = _mm256_loadu_ps(z + i);
+      if (g.fMirrorX) vx = _mm256_and_ps(vx,absMask);
+      if (g.fMirrorZ) vz = _mm256_and_ps(vz,absMask);
+      const __m256 sx = _mm256_sub_ps(vx,x0);
+      const __m256 sy = _mm256_sub_ps(_mm256_loadu_ps(y + i),y0);
+      const __m256 sz = _mm256_sub_ps(vz,z0);
+
+      /* DivRem */
+      const __m256 fi = _mm256_floor_ps(_mm256_div_ps(sx,dx));
+      const __m256 fj = _mm256_floor_ps(_mm256_div_ps(sy,dy));
+      const __m256 fk = _mm256_floor_ps(_mm256_div_ps(sz,dz));
+      const __m256 p = _mm256_div_ps(_mm256_sub_ps(sx,_mm256_mul_ps(fi,dx)),dx);
+      const __m256 q = _mm256_div_ps(_mm256_sub_ps(sy,_mm256_mul_ps(fj,dy)),dy);
+      const __m256 r = _mm256_div_ps(_mm256_sub_ps(sz,_mm256_mul_ps(fk,dz)),dz);
+
+      /* boundary check (false for NaN) */
+      const __m256 inside =
+	 _mm256_and_ps(_mm256_and_ps(_mm256_and_ps(_mm256_cmp_ps(fi,zero,_CMP_GE_OQ),
+						   _mm256_cmp_ps(fi,imax,_CMP_LT_OQ)),
+				     _mm256_and_ps(_mm256_cmp_ps(fj,zero,_CMP_GE_OQ),
+						   _mm256_cmp_ps(fj,jmax,_CMP_LT_OQ))),
+		       _mm256_and_ps(_mm256_cmp_ps(fk,zero,_CMP_GE_OQ),
+				     _mm256_cmp_ps(fk,kmax,_CMP_LT_OQ)));
+      /* a float holds the node index exactly only up to 2^24 */
+      const __m256i node =
+	 _mm256_add_epi32(_mm256_add_epi32(_mm256_mullo_epi32(_mm256_cvttps_epi32(fi),strideX),
+					   _mm256_mullo_epi32(_mm256_cvttps_epi32(fj),strideY)),
+			  _mm256_mullo_epi32(_mm256_cvttps_epi32(fk),three));
+      const __m256i index = _mm256_and_si256(node,_mm256_castps_si256(inside));
+
+      const __m256 p1 = _mm256_sub_ps(one,p);
+      const __m256 q1 = _mm256_sub_ps(one,q);
+      const __m256 r1 = _mm256_sub_ps(one,r);
+      for (int axis = 0; axis != 3; ++axis) {
+	 const float *const data = g.fData + axis;
+	 __m256 f[8];
+	 for (int c = 0; c != 8; ++c) {
+	    f[c] = _mm256_i32gather_ps(data,_mm256_add_epi32(index,corner[c]),4);
+	 }
+	 /* trilinear interpolation */
+	 const __m256 c00 = _mm256_add_ps(_mm256_mul_ps(p1,f[0]),_mm256_mul_ps(p,f[4]));
+	 const __m256 c01 = _mm256_add_ps(_mm256_mul_ps(p1,f[1]),_mm256_mul_ps(p,f[5]));
+	 const __m256 c10 = _mm256_add_ps(_mm256_mul_ps(p1,f[2]),_mm256_mul_ps(p,f[6]));
+	 const __m256 c11 = _mm256_add_ps(_mm256_mul_ps(p1,f[3]),_mm256_mul_ps(p,f[7]));
+	 const __m256 c0 = _mm256_add_ps(_mm256_mul_ps(q1,c00),_mm256_mul_ps(q,c10));
+	 const __m256 c1 = _mm256_add_ps(_mm256_mul_ps(q1,c01),_mm256_mul_ps(q,c11));
+	 const __m256 c = _mm256_add_ps(_mm256_mul_ps(r1,c0),_mm256_mul_ps(r,c1));
+	 _mm256_storeu_ps(b[axis] + i,_mm256_and_ps(_mm256_mul_ps(scale,c),inside));
+      }
+   }
+   return i;
+}
+
+__attribute__((target("avx512f,avx2")))
+size_t TSamuraiFieldSimd::EvalAVX512(const Grid &g, size_t n,
+				     const float x[], const float y[],
+				     const float z[],
+				     float bx[], float by[], float bz[])
+{
+   const __m512 zero  = _mm512_setzero_ps();
+   const __m512 one   = _mm512_set1_ps(1.f);
+   const __m512 scale = _mm512_set1_ps((float)g.fScale);
+   const __m512 dx = _mm512_set1_ps((float)g.fDx);
+   const __m512 dy = _mm512_set1_ps((float)g.fDy);
+   const __m512 dz = _mm512_set1_ps((float)g.fDz);
+   const __m512 x0 = _mm512_set1_ps((float)g.fX0);
+   const __m512 y0 = _mm512_set1_ps((float)g.fY0);
+   const __m512 z0 = _mm512_set1_ps((float)g.fZ0);
+   const __m512 imax = _mm512_set1_ps((float)(g.fNx - 1));
+   const __m512 jmax = _mm512_set1_ps((float)(g.fNy - 1));
+   const __m512 kmax = _mm512_set1_ps((float)(g.fNz - 1));
+   const __m512i strideX = _mm512_set1_epi32((int)g.fStrideX);
+   const __m512i strideY = _mm512_set1_epi32((int)g.fStrideY);
+   const __m512i three   = _mm512_set1_epi32(3);
+   const int offsets[8] = CORNER_OFFSETS(g);
+   __m512i corner[8];
+   for (int c = 0; c != 8; ++c) corner[c] = _mm512_set1_epi32(offsets[c]);
+
+   float *const b[3] = { bx, by, bz };
+   size_t i = 0;
+   for (; i + 16 <= n; i += 16) {
+      __m512 vx = _mm512_loadu_ps(x + i);
+      __m512 vz = _mm512_loadu_ps(z + i);
+      if (g.fMirrorX) vx = _mm512_abs_ps(vx);
+      if (g.fMirrorZ) vz = _mm512_abs_ps(vz);
+      const __m512 sx = _mm512_sub_ps(vx,x0);
+      const __m512 sy = _mm512_sub_ps(_mm512_loadu_ps(y + i),y0);
+      const __m512 sz = _mm512_sub_ps(vz,z0);
+
+      /* DivRem */
+      const int down = _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC;
+      const __m512 fi = _mm512_maskz_roundscale_ps(0xffff,_mm512_div_ps(sx,dx),down);
+      const __m512 fj = _mm512_maskz_roundscale_ps(0xffff,_mm512_div_ps(sy,dy),down);
+      const __m512 fk = _mm512_maskz_roundscale_ps(0xffff,_mm512_div_ps(sz,dz),down);
+      const __m512 p = _mm512_div_ps(_mm512_sub_ps(sx,_mm512_mul_ps(fi,dx)),dx);
+      const __m512 q = _mm512_div_ps(_mm512_sub_ps(sy,_mm512_mul_ps(fj,dy)),dy);
+      const __m512 r = _mm512_div_ps(_mm512_sub_ps(sz,_mm512_mul_ps(fk,dz)),dz);
+
+      /* boundary check (false for NaN) */
+      const __mmask16 inside =
+	 _mm512_cmp_ps_mask(fi,zero,_CMP_GE_OQ) & _mm512_cmp_ps_mask(fi,imax,_CMP_LT_OQ)
+	 & _mm512_cmp_ps_mask(fj,zero,_CMP_GE_OQ) & _mm512_cmp_ps_mask(fj,jmax,_CMP_LT_OQ)
+	 & _mm512_cmp_ps_mask(fk,zero,_CMP_GE_OQ) & _mm512_cmp_ps_mask(fk,kmax,_CMP_LT_OQ);
+      /* a float holds the node index exactly only up to 2^24 */
+      const __m512i index =
+	 _mm512_add_epi32(_mm512_add_epi32(_mm512_mullo_epi32(_mm512_maskz_cvttps_epi32(inside,fi),strideX),
+					   _mm512_mullo_epi32(_mm512_maskz_cvttps_epi32(inside,fj),strideY)),
+			  _mm512_mullo_epi32(_mm512_maskz_cvttps_epi32(inside,fk),three));
+
+      const __m512 p1 = _mm512_sub_ps(one,p);
+      const __m512 q1 = _mm512_sub_ps(one,q);
+      const __m512 r1 = _mm512_sub_ps(one,r);
+      for (int axis = 0; axis != 3; ++axis) {
+	 const float *const data = g.fData + axis;
+	 __m512 f[8];
+	 for (int c = 0; c != 8; ++c) {
+	    f[c] = _mm512_mask_i32gather_ps(zero,inside,_mm512_add_epi32(index,corner[c]),data,4);
+	 }
+	 /* trilinear interpolation */
+	 const __m512 c00 = _mm512_add_ps(_mm512_mul_ps(p1,f[0]),_mm512_mul_ps(p,f[4]));
+	 const __m512 c01 = _mm512_add_ps(_mm512_mul_ps(p1,f[1]),_mm512_mul_ps(p,f[5]));
+	 const __m512 c10 = _mm512_add_ps(_mm512_mul_ps(p1,f[2]),_mm512_mul_ps(p,f[6]));
+	 const __m512 c11 = _mm512_add_ps(_mm512_mul_ps(p1,f[3]),_mm512_mul_ps(p,f[7]));
+	 const __m512 c0 = _mm512_add_ps(_mm512_mul_ps(q1,c00),_mm512_mul_ps(q,c10));
+	 const __m512 c1 = _mm512_add_ps(_mm512_mul_ps(q1,c01),_mm512_mul_ps(q,c11));
+	 const __m512 c = _mm512_add_ps(_mm512_mul_ps(r1,c0),_mm512_mul_ps(r,c1));
+	 _mm512_storeu_ps(b[axis] + i,_mm512_maskz_mov_ps(inside,_mm512_mul_ps(scale,c)));
+      }
+   }
+   return i;
+}
+
+#else // no x86 vector extensions
+
+bool TSamuraiFieldSimd::HasAVX2()   { return false; }
+bool TSamuraiFieldSimd::HasAVX512() { return false; }
+
+size_t TSamuraiFieldSimd::EvalAVX2(const Grid&, size_t, const double[],
+				   const double[], const double[],
+				   double[], double[], double[])
+{
+   return 0;
+}
+
+size_t TSamuraiFieldSimd::EvalAVX512(const Grid&, size_t, const double[],
+				     const double[], const double[],
+				     double[], double[], double[])
+{
+   return 0;
+}
+
+size_t TSamuraiFieldSimd::EvalAVX2(const Grid&, size_t, const float[],
+				   const float[], const float[],
+				   float[], float[], float[])
+{
+   return 0;
+}
+
+size_t TSamuraiFieldSimd::EvalAVX512(const Grid&, size_t, const float[],
+				     const float[], const float[],
+				     float[], float[], float[])
+{
+   return 0;
+}
+
+#endif
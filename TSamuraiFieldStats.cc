@@ -0,0 +1,169 @@
+/**
+ * @file   TSamuraiFieldStats.cc
+ * @brief  access statistics of a field map
+ *
+ * @date   Created       : 2026-10-17 20:31:47 JST
+ *         Last Modified : 2026-10-17 20:31:47 JST (kawase)
+ * @author KAWASE Shoichiro <kawase@aees.kyushu-u.ac.jp>
+ *
+ *    (C) 2016 KAWASE Shoichiro
+ */
+
+#include "TSamuraiFieldStats.h"
+
+#include <algorithm>
+#include <cstring>
+#include <cerrno>
+
+using art::TSamuraiFieldStats;
+
+TSamuraiFieldStats::TSamuraiFieldStats(const TSamuraiFieldFile::Entry &grid)
+   : fGrid(grid),
+     fCount((size_t)std::max(grid.fNx - 1,0) * std::max(grid.fNy - 1,0)
+	    * std::max(grid.fNz - 1,0),0),
+     fPage((((size_t)grid.fNx * grid.fNy * grid.fNz * 3 * sizeof(float))
+	    >> kPageShift) + 1,false),
+     fEvals(0), fOutside(0), fCells(0), fPages(0)
+{
+}
+
+void TSamuraiFieldStats::Reset()
+{
+   std::fill(fCount.begin(),fCount.end(),0);
+   fPage.assign(fPage.size(),false);
+   fEvals = fOutside = fCells = fPages = 0;
+}
+
+void TSamuraiFieldStats::Record(bool inside, int i, int j, int k)
+{
+   ++fEvals;
+   if (!inside) {
+      ++fOutside;
+      return;
+   }
+   uint32_t &count = fCount[Cell(i,j,k)];
+   if (!count) {
+      ++fCells;
+      TouchPages(i,j,k);
+   }
+   if (count != 0xffffffffU) ++count;
+}
+
+void TSamuraiFieldStats::TouchPages(int i, int j, int k)
+{
+   /* corners (di,dj,0) and (di,dj,1) are adjacent: 4 runs of 24 bytes */
+   const size_t strideY = (size_t)fGrid.fNz * 3;
+   const size_t strideX = (size_t)fGrid.fNy * strideY;
+   for (int di = 0; di != 2; ++di) {
+      for (int dj = 0; dj != 2; ++dj) {
+	 const size_t head =
+	    ((i + di) * strideX + (j + dj) * strideY + k * 3) * sizeof(float);
+	 const size_t tail = head + 6 * sizeof(float) - 1;
+	 for (size_t page = head >> kPageShift; page <= tail >> kPageShift;
+	      ++page) {
+	    if (!fPage[page]) {
+	       fPage[page] = true;
+	       ++fPages;
+	    }
+	 }
+      }
+   }
+}
+
+unsigned long TSamuraiFieldStats::GetTiles(int edge,
+					   unsigned long *total) const
+{
+   if (edge < 1) return 0;
+   const int ntx = (fGrid.fNx - 1 + edge - 1) / edge;
+   const int nty = (fGrid.fNy - 1 + edge - 1) / edge;
+   const int ntz = (fGrid.fNz - 1 + edge - 1) / edge;
+   if (total) *total = (unsigned long)ntx * nty * ntz;
+   std::vector<bool> touched((size_t)ntx * nty * ntz,false);
+   unsigned long tiles = 0;
+   for (int i = 0; i < fGrid.fNx - 1; ++i) {
+      for (int j = 0; j < fGrid.fNy - 1; ++j) {
+	 for (int k = 0; k < fGrid.fNz - 1; ++k) {
+	    if (!fCount[Cell(i,j,k)]) continue;
+	    const size_t tile =
+	       ((size_t)(i / edge) * nty + j / edge) * ntz + k / edge;
+	    if (!touched[tile]) {
+	       touched[tile] = true;
+	       ++tiles;
+	    }
+	 }
+      }
+   }
+   return tiles;
+}
+
+void TSamuraiFieldStats::Print(FILE *fp) const
+{
+   fprintf(fp,"field stats: %lu lookups, %lu out of the domain (%.1f %%)\n",
+	   fEvals,fOutside,fEvals ? 100. * fOutside / fEvals : 0.);
+   fprintf(fp,"  cells touched: %lu of %lu (%.1f %%), pages touched: %lu (%.1f of %.1f MB)\n",
+	   fCells,(unsigned long)fCount.size(),
+	   fCount.empty() ? 0. : 100. * fCells / fCount.size(),
+	   fPages,fPages * (1 << kPageShift) / 1048576.,
+	   fPage.size() * (1 << kPageShift) / 1048576.);
+   if (!fCells) return;
+
+   /* bounding box of the touched cells */
+   int lo[3] = { fGrid.fNx, fGrid.fNy, fGrid.fNz };
+   int hi[3] = { -1, -1, -1 };
+   for (int i = 0; i < fGrid.fNx - 1; ++i) {
+      for (int j = 0; j < fGrid.fNy - 1; ++j) {
+	 for (int k = 0; k < fGrid.fNz - 1; ++k) {
+	    if (!fCount[Cell(i,j,k)]) continue;
+	    const int n[3] = { i, j, k };
+	    for (int axis = 0; axis != 3; ++axis) {
+	       lo[axis] = std::min(lo[axis],n[axis]);
+	       hi[axis] = std::max(hi[axis],n[axis] + 1);
+	    }
+	 }
+      }
+   }
+   fprintf(fp,"  touched region (mm): %s %g..%g, y %g..%g, %s %g..%g\n",
+	   fGrid.fFlags & TSamuraiFieldFile::kMirrorX ? "|x|" : "x",
+	   fGrid.fX0 + lo[0] * fGrid.fDx,fGrid.fX0 + hi[0] * fGrid.fDx,
+	   fGrid.fY0 + lo[1] * fGrid.fDy,fGrid.fY0 + hi[1] * fGrid.fDy,
+	   fGrid.fFlags & TSamuraiFieldFile::kMirrorZ ? "|z|" : "z",
+	   fGrid.fZ0 + lo[2] * fGrid.fDz,fGrid.fZ0 + hi[2] * fGrid.fDz);
+
+   static const int kEdge[] = { 8, 16, 32 };
+   fprintf(fp,"  tiles touched:");
+   for (size_t n = 0; n != sizeof(kEdge) / sizeof(kEdge[0]); ++n) {
+      unsigned long total;
+      const unsigned long tiles = GetTiles(kEdge[n],&total);
+      fprintf(fp,"%s %lu of %lu (%d^3 cells)",n ? "," : "",tiles,total,kEdge[n]);
+   }
+   fprintf(fp,"\n");
+}
+
+bool TSamuraiFieldStats::WriteHeatmap(const char *filename) const
+{
+   FILE *const fp = fopen(filename,"w");
+   if (!fp) {
+      printf("TSamuraiFieldStats::WriteHeatmap() : cannot open %s (%s)\n",
+	     filename,strerror(errno));
+      return false;
+   }
+   fprintf(fp,"# i j k x y z count (cell centre in mm)\n");
+   for (int i = 0; i < fGrid.fNx - 1; ++i) {
+      for (int j = 0; j < fGrid.fNy - 1; ++j) {
+	 for (int k = 0; k < fGrid.fNz - 1; ++k) {
+	    const uint32_t count = fCount[Cell(i,j,k)];
+	    if (!count) continue;
+	    fprintf(fp,"%d %d %d %g %g %g %u\n",i,j,k,
+		    fGrid.fX0 + (i + 0.5) * fGrid.fDx,
+		    fGrid.fY0 + (j + 0.5) * fGrid.fDy,
+		    fGrid.fZ0 + (k + 0.5) * fGrid.fDz,count);
+	 }
+      }
+   }
+   const bool good = !ferror(fp);
+   if (fclose(fp) || !good) {
+      printf("TSamuraiFieldStats::WriteHeatmap() : cannot write %s\n",filename);
+      return false;
+   }
+   return true;
+}
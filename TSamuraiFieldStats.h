@@ -0,0 +1,82 @@
+/**
+ * @file   TSamuraiFieldStats.h
+ * @brief  access statistics of a field map
+ *
+ * @date   Created       : 2026-10-17 20:31:47 JST
+ *         Last Modified : 2026-10-17 20:31:47 JST (kawase)
+ * @author KAWASE Shoichiro <kawase@aees.kyushu-u.ac.jp>
+ *
+ *    (C) 2016 KAWASE Shoichiro
+ */
+
+#ifndef INCLUDE_GUARD_UUID_E24B7F05_9C3A_4D61_8F2E_07B5A1D9C6E4
+#define INCLUDE_GUARD_UUID_E24B7F05_9C3A_4D61_8F2E_07B5A1D9C6E4
+
+#include "TSamuraiFieldFile.h"
+
+#include <cstddef>
+#include <cstdio>
+#include <vector>
+
+#include <stdint.h>
+
+namespace art {
+   class TSamuraiFieldStats;
+}
+
+////////////////////////////////////////////////////////////
+///
+/// Where a workload reads a field map. Every lookup is recorded with
+/// the cell it falls in, or as out of the domain (the field is then
+/// returned as zero). Kept are the number of lookups per cell (the
+/// heatmap) and the 4 kB pages of the node-major float map holding the
+/// corners of the cells read, i.e. what a mapped map faults in.
+///
+/// From these Print() derives the region of the map actually used and
+/// the number of tiles a tiled container would decompress for a few
+/// tile edges, which is what cache sizes, tile edges and crop regions
+/// are chosen from. WriteHeatmap() writes the touched cells as a text
+/// table (cell centre and count, e.g. for TTree::ReadFile).
+///
+/// TSamuraiMagnetField only records when compiled with
+/// SAMURAI_FIELD_STATS (make FIELD_STATS=1); otherwise no statistics
+/// object exists and Eval() carries no instrumentation at all. The
+/// counters are not synchronized: record from one thread only.
+///
+
+class art::TSamuraiFieldStats {
+public:
+   explicit TSamuraiFieldStats(const TSamuraiFieldFile::Entry &grid);
+
+   void Record(bool inside, int i, int j, int k);
+   void Reset();
+
+   unsigned long GetEvals() const {return fEvals;}
+   unsigned long GetOutside() const {return fOutside;}
+   unsigned long GetCells() const {return fCells;}
+   unsigned long GetPages() const {return fPages;}
+   // count of cell (i,j,k)
+   uint32_t GetCount(int i, int j, int k) const
+   {return fCount[Cell(i,j,k)];}
+   // tiles of edge^3 cells containing touched cells (total: of the map)
+   unsigned long GetTiles(int edge, unsigned long *total = NULL) const;
+
+   void Print(FILE *fp = stdout) const;
+   bool WriteHeatmap(const char *filename) const;
+
+private:
+   static const int kPageShift = 12;
+   TSamuraiFieldFile::Entry fGrid;
+   std::vector<uint32_t> fCount; // [nx-1][ny-1][nz-1], saturating
+   std::vector<bool> fPage;      // touched pages of the float map
+   unsigned long fEvals;
+   unsigned long fOutside;
+   unsigned long fCells;
+   unsigned long fPages;
+
+   size_t Cell(int i, int j, int k) const
+   { return ((size_t)i * (fGrid.fNy - 1) + j) * (fGrid.fNz - 1) + k; }
+   void TouchPages(int i, int j, int k);
+};
+
+#endif // INCLUDE_GUARD_UUID_E24B7F05_9C3A_4D61_8F2E_07B5A1D9C6E4
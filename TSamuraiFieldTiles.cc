@@ -0,0 +1,166 @@
+/**
+ * @file   TSamuraiFieldTiles.cc
+ * @brief  compressed tile set of a field map with LRU tile cache
+ *
+ * @date   Created       : 2026-10-17 13:25:07 JST
+ *         Last Modified : 2026-10-17 13:25:07 JST (kawase)
+ * @author KAWASE Shoichiro <kawase@aees.kyushu-u.ac.jp>
+ *
+ *    (C) 2016 KAWASE Shoichiro
+ */
+
+#include "TSamuraiFieldTiles.h"
+
+#include <cstdio>
+#include <fcntl.h>
+#include <unistd.h>
+
+using art::TSamuraiFieldTiles;
+using art::TSamuraiFieldFile;
+
+TSamuraiFieldTiles::TSamuraiFieldTiles()
+   : fFd(-1), fOffset(0), fNx(0), fNy(0), fNz(0), fHeader(), fIndex(),
+     fCapacity(kDefaultCapacity), fMaxRawSize(0),
+     fTileSlot(), fSlots(), fLRU(), fCompressed(), fHits(0), fMisses(0)
+{
+}
+
+TSamuraiFieldTiles::~TSamuraiFieldTiles()
+{
+   Clear();
+   if (fFd >= 0) close(fFd);
+}
+
+void TSamuraiFieldTiles::Clear()
+{
+   for (size_t s = 0; s != fSlots.size(); ++s) {
+      delete [] fSlots[s].fData;
+   }
+   fSlots.clear();
+   fLRU.clear();
+   fTileSlot.assign(fIndex.size(),-1);
+}
+
+bool TSamuraiFieldTiles::Open(const char* filename,
+			      const TSamuraiFieldFile::Entry &entry,
+			      size_t capacity)
+{
+   fFd = open(filename,O_RDONLY);
+   if (fFd < 0) {
+      printf("TSamuraiFieldTiles::Open() : Cannot open file: %s\n",filename);
+      return false;
+   }
+
+   fOffset = entry.fOffset;
+   fNx = entry.fNx;
+   fNy = entry.fNy;
+   fNz = entry.fNz;
+
+   if (pread(fFd,&fHeader,sizeof(fHeader),fOffset) != sizeof(fHeader)
+       || fHeader.fTile <= 0) {
+      printf("TSamuraiFieldTiles::Open() : broken tile header in %s\n",filename);
+      close(fFd);
+      fFd = -1;
+      return false;
+   }
+
+   const size_t nTile = (size_t)fHeader.fNTx * fHeader.fNTy * fHeader.fNTz;
+   const ssize_t indexSize = sizeof(TSamuraiFieldFile::TileIndex) * nTile;
+   fIndex.resize(nTile);
+   if (pread(fFd,&fIndex[0],indexSize,fOffset + sizeof(fHeader)) != indexSize) {
+      printf("TSamuraiFieldTiles::Open() : broken tile index in %s\n",filename);
+      close(fFd);
+      fFd = -1;
+      return false;
+   }
+
+   fMaxRawSize = 0;
+   for (size_t t = 0; t != nTile; ++t) {
+      if (fIndex[t].fRawSize > fMaxRawSize) fMaxRawSize = fIndex[t].fRawSize;
+   }
+
+   fCapacity = capacity ? capacity : 1;
+   Clear();
+   return true;
+}
+
+void TSamuraiFieldTiles::SetCapacity(size_t capacity)
+{
+   fCapacity = capacity ? capacity : 1;
+   Clear();
+}
+
+size_t TSamuraiFieldTiles::GetResidentBytes() const
+{
+   return fSlots.size() * fMaxRawSize;
+}
+
+const float* TSamuraiFieldTiles::Load(int tile) const
+{
+   const int cached = fTileSlot[tile];
+   if (cached >= 0) {
+      ++fHits;
+      const Slot &slot = fSlots[cached];
+      if (slot.fPos != fLRU.begin()) {
+	 fLRU.splice(fLRU.begin(),fLRU,slot.fPos);
+      }
+      return slot.fData;
+   }
+
+   ++fMisses;
+   int s;
+   if (fSlots.size() < fCapacity) {
+      s = fSlots.size();
+      Slot slot;
+      slot.fTile = -1;
+      slot.fData = new float[fMaxRawSize / sizeof(float)];
+      fLRU.push_front(s);
+      slot.fPos = fLRU.begin();
+      fSlots.push_back(slot);
+   } else {
+      s = fLRU.back();
+      /* a slot whose tile failed to load holds none */
+      if (fSlots[s].fTile >= 0) fTileSlot[fSlots[s].fTile] = -1;
+      fLRU.splice(fLRU.begin(),fLRU,fSlots[s].fPos);
+   }
+
+   Slot &slot = fSlots[s];
+   const TSamuraiFieldFile::TileIndex &idx = fIndex[tile];
+   fCompressed.resize(idx.fSize);
+   if (pread(fFd,&fCompressed[0],idx.fSize,fOffset + idx.fOffset)
+       != (ssize_t)idx.fSize
+       || !TSamuraiFieldFile::DecodeTile(&fCompressed[0],idx.fSize,
+					 slot.fData,idx.fRawSize)) {
+      printf("TSamuraiFieldTiles::Load() : cannot read tile %d\n",tile);
+      slot.fTile = -1;
+      fLRU.splice(fLRU.end(),fLRU,slot.fPos);
+      return NULL;
+   }
+
+   slot.fTile = tile;
+   fTileSlot[tile] = s;
+   return slot.fData;
+}
+
+bool TSamuraiFieldTiles::Corners(int i, int j, int k, const float *f[8]) const
+{
+   const int n = fHeader.fTile;
+   const int tx = i / n, ty = j / n, tz = k / n;
+   const float *const data =
+      Load((tx * fHeader.fNTy + ty) * fHeader.fNTz + tz);
+   if (!data) return false;
+
+   /* node strides inside the tile */
+   const size_t sy = TSamuraiFieldFile::TileNodes(fNz,n,tz) * 3;
+   const size_t sx = TSamuraiFieldFile::TileNodes(fNy,n,ty) * sy;
+
+   f[0] = data + (i - tx * n) * sx + (j - ty * n) * sy + (k - tz * n) * 3;
+   f[1] = f[0] + 3;
+   f[2] = f[0] + sy;
+   f[3] = f[2] + 3;
+   f[4] = f[0] + sx;
+   f[5] = f[4] + 3;
+   f[6] = f[4] + sy;
+   f[7] = f[6] + 3;
+   return true;
+}
@@ -0,0 +1,84 @@
+/**
+ * @file   TSamuraiFieldTiles.h
+ * @brief  compressed tile set of a field map with LRU tile cache
+ *
+ * @date   Created       : 2026-10-17 13:25:07 JST
+ *         Last Modified : 2026-10-17 13:25:07 JST (kawase)
+ * @author KAWASE Shoichiro <kawase@aees.kyushu-u.ac.jp>
+ *
+ *    (C) 2016 KAWASE Shoichiro
+ */
+
+#ifndef INCLUDE_GUARD_UUID_6E4F8C2D_1B7A_4D93_A0E5_9C2F7B41D386
+#define INCLUDE_GUARD_UUID_6E4F8C2D_1B7A_4D93_A0E5_9C2F7B41D386
+
+#include "TSamuraiFieldFile.h"
+
+#include <list>
+#include <vector>
+
+namespace art {
+   class TSamuraiFieldTiles;
+}
+
+////////////////////////////////////////////////////////////
+///
+/// Tiles of a kTiled container entry are decompressed on first access
+/// and kept in a cache of at most GetCapacity() tiles; the least
+/// recently used tile is evicted when the cache is full. Resident
+/// memory is therefore bounded by the capacity, not by the map size.
+///
+/// Not thread safe: the cache is modified by const lookups.
+///
+
+class art::TSamuraiFieldTiles {
+public:
+   static const size_t kDefaultCapacity = 256;
+
+   TSamuraiFieldTiles();
+   ~TSamuraiFieldTiles();
+
+   bool Open(const char* filename, const TSamuraiFieldFile::Entry &entry,
+	     size_t capacity = kDefaultCapacity);
+   bool IsGood() const {return fFd >= 0;}
+
+   // pointers to the 8 corners of cell (i,j,k), ordered as
+   // n = (di << 2) | (dj << 1) | dk. false if the tile is unreadable.
+   bool Corners(int i, int j, int k, const float *f[8]) const;
+
+   size_t GetCapacity() const {return fCapacity;}
+   void SetCapacity(size_t capacity);
+   unsigned long GetHits() const {return fHits;}
+   unsigned long GetMisses() const {return fMisses;}
+   size_t GetResidentBytes() const;
+
+private:
+   struct Slot {
+      int    fTile;
+      float *fData;
+      std::list<int>::iterator fPos; // position in fLRU
+   };
+
+   int    fFd;
+   uint64_t fOffset;                 // payload offset in the file
+   int    fNx, fNy, fNz;             // nodes of the map
+   TSamuraiFieldFile::TileHeader fHeader;
+   std::vector<TSamuraiFieldFile::TileIndex> fIndex;
+   size_t fCapacity;
+   size_t fMaxRawSize;
+
+   mutable std::vector<int>  fTileSlot; // tile -> slot, -1 if not cached
+   mutable std::vector<Slot> fSlots;
+   mutable std::list<int>    fLRU;      // slots, most recently used first
+   mutable std::vector<char> fCompressed;
+   mutable unsigned long fHits;
+   mutable unsigned long fMisses;
+
+   const float* Load(int tile) const;
+   void Clear();
+
+   TSamuraiFieldTiles(const TSamuraiFieldTiles&);            // undefined
+   TSamuraiFieldTiles& operator=(const TSamuraiFieldTiles&); // undefined
+};
+
+#endif // INCLUDE_GUARD_UUID_6E4F8C2D_1B7A_4D93_A0E5_9C2F7B41D386
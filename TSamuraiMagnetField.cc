@@ -10,31 +10,400 @@
  */
 
 #include "TSamuraiMagnetField.h"
+#include "TSamuraiFieldTiles.h"
+#include "TSamuraiFieldRegistry.h"
+#include "TSamuraiFieldArena.h"
+#include "TSamuraiFieldGrid.h"
+#include "TSamuraiFieldSimd.h"
+#include "TSamuraiFieldCubic.h"
+#include "TSamuraiFieldStats.h"
+#include "TSamuraiPrecision.h"
 
+#include <algorithm>
 #include <fstream>
 #include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 using art::TSamuraiMagnetField;
 
+using art::TSamuraiFieldSimd;
+using art::TDoublePrecision;
+using art::TSinglePrecision;
+
+const double TSamuraiMagnetField::kPlanarTolerance = 1e-6;
+
+namespace {
+   TSamuraiMagnetField::EVectorISA BestVectorISA()
+   {
+      if (TSamuraiFieldSimd::HasAVX512()) return TSamuraiMagnetField::kAVX512;
+      if (TSamuraiFieldSimd::HasAVX2()) return TSamuraiMagnetField::kAVX2;
+      return TSamuraiMagnetField::kScalar;
+   }
+}
+
 TSamuraiMagnetField::TSamuraiMagnetField(const char* filename, double scale,
 					 int nx, int ny, int nz,
-					 double dx, double dy, double dz)
-   : fField(NULL), fNx(nx), fNy(ny), fNz(nz), fDx(dx), fDy(dy), fDz(dz),
+					 double dx, double dy, double dz,
+					 EStorage storage)
+   : fData(NULL), fBuffer(NULL), fMapAddress(NULL), fMapLength(0),
+     fStorage(storage), fLayout(kNodeMajor), fCells(NULL),
+     fMidplane(NULL), fQuantization(kFloat), fQuant(NULL),
+     fQuantScale(NULL), fQuantOffset(NULL), fQuantizationError(0.),
+     fTiles(NULL), fSharedMap(NULL), fSharedCells(NULL), fArena(NULL),
+     fReplicas(), fFileName(""), fLevel(0),
+     fGeneric(false), fKernel(NULL), fVectorISA(BestVectorISA()),
+     fCubic(NULL), fStats(NULL),
+     fNx(0), fNy(0), fNz(0), fDx(0), fDy(0), fDz(0), fX0(0), fY0(0), fZ0(0),
+     fMirrorX(true), fMirrorZ(true), fStrideX(0), fStrideY(0), fInfo(),
+     fScale(scale), fIsGood(false)
+{
+   TSamuraiFieldFile::Entry legacy = TSamuraiFieldFile::Entry();
+   TSamuraiFieldFile::SetLegacyGeometry(&legacy,nx,ny,nz,dx,dy,dz);
+   Init(filename,NULL,legacy);
+}
+
+TSamuraiMagnetField::TSamuraiMagnetField(const char* filename,
+					 const char* mapName,
+					 double scale, EStorage storage)
+   : fData(NULL), fBuffer(NULL), fMapAddress(NULL), fMapLength(0),
+     fStorage(storage), fLayout(kNodeMajor), fCells(NULL),
+     fMidplane(NULL), fQuantization(kFloat), fQuant(NULL),
+     fQuantScale(NULL), fQuantOffset(NULL), fQuantizationError(0.),
+     fTiles(NULL), fSharedMap(NULL), fSharedCells(NULL), fArena(NULL),
+     fReplicas(), fFileName(""), fLevel(0),
+     fGeneric(false), fKernel(NULL), fVectorISA(BestVectorISA()),
+     fCubic(NULL), fStats(NULL),
+     fNx(0), fNy(0), fNz(0), fDx(0), fDy(0), fDz(0), fX0(0), fY0(0), fZ0(0),
+     fMirrorX(true), fMirrorZ(true), fStrideX(0), fStrideY(0), fInfo(),
      fScale(scale), fIsGood(false)
 {
+   TSamuraiFieldFile::Entry legacy = TSamuraiFieldFile::Entry();
+   TSamuraiFieldFile::SetLegacyGeometry(&legacy);
+   Init(filename,mapName,legacy);
+}
+
+TSamuraiMagnetField::TSamuraiMagnetField(const TSamuraiFieldFile::Entry &info,
+					 float *data)
+   : fData(data), fBuffer(data), fMapAddress(NULL), fMapLength(0),
+     fStorage(kHeap), fLayout(kNodeMajor), fCells(NULL),
+     fMidplane(NULL), fQuantization(kFloat), fQuant(NULL),
+     fQuantScale(NULL), fQuantOffset(NULL), fQuantizationError(0.),
+     fTiles(NULL), fSharedMap(NULL), fSharedCells(NULL), fArena(NULL),
+     fReplicas(), fFileName(""), fLevel(0),
+     fGeneric(false), fKernel(NULL), fVectorISA(BestVectorISA()),
+     fCubic(NULL), fStats(NULL),
+     fNx(0), fNy(0), fNz(0), fDx(0), fDy(0), fDz(0), fX0(0), fY0(0), fZ0(0),
+     fMirrorX(true), fMirrorZ(true), fStrideX(0), fStrideY(0), fInfo(),
+     fScale(1.), fIsGood(true)
+{
+   std::fill(fPyramid,fPyramid + kMaxLevel,(TSamuraiMagnetField*)NULL);
+   SetGeometry(info);
+   SelectKernel();
+}
+
+void TSamuraiMagnetField::Init(const char* filename, const char* mapName,
+			       const TSamuraiFieldFile::Entry &legacy)
+{
+   std::fill(fPyramid,fPyramid + kMaxLevel,(TSamuraiMagnetField*)NULL);
+   fFileName = filename;
+   TSamuraiFieldFile file;
+   if (file.Open(filename)) {
+      const int index = file.FindMap(mapName);
+      if (index < 0) {
+	 printf("TSamuraiMagnetField::TSamuraiMagnetField(): No map \"%s\" in %s\n",
+		mapName ? mapName : "",filename);
+	 return;
+      }
+      fInfo = file.GetEntry(index);
+   } else {
+      if (mapName && *mapName) {
+	 printf("TSamuraiMagnetField::TSamuraiMagnetField(): %s is not a field container\n",
+		filename);
+	 return;
+      }
+      fInfo = legacy;
+      fInfo.fOffset = 0;
+   }
+   SetGeometry(fInfo);
+
    /* ny should be odd */
    if (fNy % 2 == 0) {
       printf("TSamuraiMagnetField::TSamuraiMagnetField(): ny must be odd but it is even.\n");
       return;
    }
 
+   if (fInfo.fFlags & TSamuraiFieldFile::kTiled) {
+      fStorage = kTiled;
+      fTiles = new TSamuraiFieldTiles;
+      fIsGood = fTiles->Open(filename,fInfo);
+      return;
+   }
+
    const size_t expectedFileSize =
       sizeof(float) * fNx * fNy * fNz * kDimension;
+   if (fInfo.fSize != expectedFileSize) {
+      printf("TSamuraiMagnetField::TSamuraiMagnetField(): Map size mismatch!\n");
+      return;
+   }
+
+   if (fStorage == kShared
+       && !AttachShared(filename,expectedFileSize)) {
+      printf("TSamuraiMagnetField::TSamuraiMagnetField(): shared memory failed, mapping file.\n");
+      fStorage = kMmap;
+   }
+
+   if (fStorage == kMmap
+       && !MapFile(filename,fInfo.fOffset,expectedFileSize)) {
+      printf("TSamuraiMagnetField::TSamuraiMagnetField(): mmap failed, reading into memory.\n");
+      fStorage = kHeap;
+   }
+
+   if (fStorage == kHeap) {
+      fBuffer = new float[expectedFileSize / sizeof(float)];
+      if (!ReadFile(filename,fInfo.fOffset,expectedFileSize,fBuffer)) {
+	 return;
+      }
+      fData = fBuffer;
+   }
 
+   fIsGood = true;
+   SelectKernel();
+}
+
+void TSamuraiMagnetField::SetGeometry(const TSamuraiFieldFile::Entry &info)
+{
+   fInfo = info;
+   fNx = fInfo.fNx;
+   fNy = fInfo.fNy;
+   fNz = fInfo.fNz;
+   fDx = fInfo.fDx;
+   fDy = fInfo.fDy;
+   fDz = fInfo.fDz;
+   fX0 = fInfo.fX0;
+   fY0 = fInfo.fY0;
+   fZ0 = fInfo.fZ0;
+   fMirrorX = fInfo.fFlags & TSamuraiFieldFile::kMirrorX;
+   fMirrorZ = fInfo.fFlags & TSamuraiFieldFile::kMirrorZ;
+   fStrideX = (size_t)fNy * fNz * kDimension;
+   fStrideY = (size_t)fNz * kDimension;
+#ifdef SAMURAI_FIELD_STATS
+   delete fStats;
+   fStats = new TSamuraiFieldStats(fInfo);
+#endif
+}
+
+void TSamuraiMagnetField::SelectKernel()
+{
+   fKernel = NULL;
+   if (fGeneric || fTiles || fCubic || fQuantization != kFloat
+       || fLayout != kNodeMajor
+       || !fMirrorX || !fMirrorZ || fX0 != 0. || fZ0 != 0.
+       || fY0 != -(fNy / 2) * fDy) {
+      return;
+   }
+   if (fNx == 301 && fNy == 81 && fNz == 301
+       && fDx == 10. && fDy == 10. && fDz == 10.) {
+      fKernel = &TSamuraiFieldGrid<301,81,301,10,10,10>::Eval;
+   }
+}
+
+bool TSamuraiMagnetField::SetVectorISA(EVectorISA isa)
+{
+   if ((isa == kAVX2 && !TSamuraiFieldSimd::HasAVX2())
+       || (isa == kAVX512 && !TSamuraiFieldSimd::HasAVX512())) {
+      printf("TSamuraiMagnetField::SetVectorISA() : %s is not supported by this CPU.\n",
+	     isa == kAVX2 ? "AVX2" : "AVX-512");
+      return false;
+   }
+   fVectorISA = isa;
+   for (int i = 0; i != kMaxLevel; ++i) {
+      if (fPyramid[i]) fPyramid[i]->fVectorISA = isa;
+   }
+   return true;
+}
+
+TSamuraiMagnetField::~TSamuraiMagnetField()
+{
+   for (int i = 0; i != kMaxLevel; ++i) {
+      delete fPyramid[i];
+      fPyramid[i] = NULL;
+   }
+   ReleaseMap();
+   ReleaseCells();
+   delete [] fMidplane;
+   fMidplane = NULL;
+   delete [] fQuant;
+   fQuant = NULL;
+   delete [] fQuantScale;
+   fQuantScale = NULL;
+   delete [] fQuantOffset;
+   fQuantOffset = NULL;
+   delete fTiles;
+   fTiles = NULL;
+   delete fStats;
+   fStats = NULL;
+}
+
+void TSamuraiMagnetField::ReleaseMap()
+{
+   if (fMapAddress) {
+      munmap(fMapAddress,fMapLength);
+      fMapAddress = NULL;
+   }
+   delete [] fBuffer;
+   fBuffer = NULL;
+   delete fSharedMap;
+   fSharedMap = NULL;
+   if (fArena && fLayout == kNodeMajor) {
+      delete fArena;
+      fArena = NULL;
+      fReplicas.clear();
+   }
+   fData = NULL;
+   delete fCubic;
+   fCubic = NULL;
+}
+
+bool TSamuraiMagnetField::SetLayout(ELayout layout)
+{
+   if (!IsGood() || layout == fLayout) return IsGood();
+   if (!fData) {
+      printf("TSamuraiMagnetField::SetLayout() : float map already released.\n");
+      return false;
+   }
+   if (fArena) {
+      printf("TSamuraiMagnetField::SetLayout() : call SetArena() after SetLayout().\n");
+      return false;
+   }
+
+   if (layout == kNodeMajor) {
+      ReleaseCells();
+      fLayout = kNodeMajor;
+      SelectKernel();
+      return true;
+   }
+
+   const size_t nCell = (size_t)(fNx-1) * (fNy-1) * (fNz-1);
+   const size_t size = sizeof(float) * kCellSize * nCell;
+   if (fStorage == kShared) {
+      /* share the re-layouted copy as well */
+      fSharedCells = new TSamuraiFieldRegistry;
+      const std::string key =
+	 TSamuraiFieldRegistry::MakeKey(fFileName.c_str(),fInfo.fName,
+					fInfo.fChecksum,"cell");
+      const TSamuraiFieldRegistry::EState state = fSharedCells->Attach(key,size);
+      fCells = static_cast<float*>(fSharedCells->GetData());
+      if (state == TSamuraiFieldRegistry::kAttached) {
+	 fLayout = kCellMajor;
+	 SelectKernel();
+	 return true;
+      } else if (state == TSamuraiFieldRegistry::kFailed) {
+	 delete fSharedCells;
+	 fSharedCells = NULL;
+	 fCells = NULL;
+      }
+   }
+
+   void *buf = NULL;
+   if (!fCells && posix_memalign(&buf,64,size)) {
+      printf("TSamuraiMagnetField::SetLayout() : Cannot allocate %lu MB for cell-major layout.\n",
+	     size >> 20);
+      return false;
+   }
+   if (!fCells) fCells = static_cast<float*>(buf);
+
+   for (int i = 0; i != fNx - 1; ++i) {
+      for (int j = 0; j != fNy - 1; ++j) {
+	 float *cell = fCells + ((size_t)i * (fNy-1) + j) * (fNz-1) * kCellSize;
+	 for (int k = 0; k != fNz - 1; ++k, cell += kCellSize) {
+	    const float *f[kCorner];
+	    Corners(fData,i,j,k,f);
+	    for (int n = 0; n != kCorner; ++n) {
+	       std::copy(f[n],f[n] + kDimension,cell + n * kDimension);
+	    }
+	 }
+      }
+   }
+
+   if (fSharedCells) fSharedCells->Publish();
+   fLayout = kCellMajor;
+   SelectKernel();
+   return true;
+}
+
+void TSamuraiMagnetField::ReleaseCells()
+{
+   if (fArena && fLayout == kCellMajor) {
+      delete fArena;
+      fArena = NULL;
+      fReplicas.clear();
+   } else if (fSharedCells) {
+      delete fSharedCells;
+      fSharedCells = NULL;
+   } else {
+      free(fCells);
+   }
+   fCells = NULL;
+}
+
+bool TSamuraiMagnetField::MapFile(const char* filename,
+				  size_t offset, size_t size)
+{
+   const int fd = open(filename,O_RDONLY);
+   if (fd < 0) {
+      return false;
+   }
+
+   struct stat st;
+   if (fstat(fd,&st) || (size_t)st.st_size < offset + size
+       || (offset == 0 && (size_t)st.st_size != size)) {
+      close(fd);
+      return false;
+   }
+
+   /* mmap offset has to be page aligned */
+   const size_t page = sysconf(_SC_PAGESIZE);
+   const size_t skip = offset % page;
+
+   void *const addr = mmap(NULL,size + skip,PROT_READ,MAP_SHARED,
+			   fd,offset - skip);
+   close(fd); // the mapping keeps its own reference to the file
+   if (addr == MAP_FAILED) {
+      return false;
+   }
+
+   fMapAddress = addr;
+   fMapLength  = size + skip;
+   fData       = reinterpret_cast<const float*>((const char*)addr + skip);
+   return true;
+}
+
+void TSamuraiMagnetField::Prefetch() const
+{
+   if (!fMapAddress) return;
+   madvise(fMapAddress,fMapLength,MADV_WILLNEED);
+   const size_t page = sysconf(_SC_PAGESIZE);
+   volatile char sum = 0;
+   for (size_t offset = 0; offset < fMapLength; offset += page) {
+      sum += static_cast<const char*>(fMapAddress)[offset];
+   }
+}
+
+bool TSamuraiMagnetField::ReadFile(const char* filename,
+				   size_t offset, size_t size, float *dst)
+{
    std::ifstream ifs(filename,std::ios::binary);
    if (!ifs) {
       printf("TSamuraiMagnetField::TSamuraiMagnetField(): Cannot open file: %s\n",filename);
-      return;
+      return false;
    }
 
    { /* check whether file size is correct */
@@ -45,49 +414,588 @@ TSamuraiMagnetField::TSamuraiMagnetField(const char* filename, double scale,
       const size_t beginPos = ifs.tellg();
       const size_t fileSize = endPos - beginPos;
 
-      if (fileSize != expectedFileSize) {
+      if (offset ? fileSize < offset + size : fileSize != size) {
 	 printf("TSamuraiMagnetField::TSamuraiMagnetField(): File size mismatch!\n");
-	 printf("File size = %lu while %lu expected\n",fileSize,expectedFileSize);
-	 return;
+	 printf("File size = %lu while %lu expected\n",fileSize,offset + size);
+	 return false;
+      }
+   }
+
+   ifs.seekg(offset, std::fstream::beg);
+   ifs.read((char*)dst, size);
+   return ifs.good();
+}
+
+bool TSamuraiMagnetField::AttachShared(const char* filename, size_t size)
+{
+   fSharedMap = new TSamuraiFieldRegistry;
+   const std::string key =
+      TSamuraiFieldRegistry::MakeKey(filename,fInfo.fName,fInfo.fChecksum,"node");
+
+   switch (fSharedMap->Attach(key,size)) {
+      case TSamuraiFieldRegistry::kCreated:
+	 if (!ReadFile(filename,fInfo.fOffset,size,
+		       static_cast<float*>(fSharedMap->GetData()))) {
+	    fSharedMap->Abandon();
+	    break;
+	 }
+	 fSharedMap->Publish();
+	 printf("TSamuraiMagnetField::TSamuraiMagnetField(): created shared segment %s\n",
+		key.c_str());
+	 fData = static_cast<const float*>(fSharedMap->GetData());
+	 return true;
+      case TSamuraiFieldRegistry::kAttached:
+	 printf("TSamuraiMagnetField::TSamuraiMagnetField(): attached shared segment %s\n",
+		key.c_str());
+	 fData = static_cast<const float*>(fSharedMap->GetData());
+	 return true;
+      default:
+	 break;
+   }
+
+   delete fSharedMap;
+   fSharedMap = NULL;
+   return false;
+}
+
+bool TSamuraiMagnetField::Blend(bool byCurrent, double value)
+{
+   if (!IsGood()) return false;
+   if (!fData || fLayout != kNodeMajor || fMidplane || fArena) {
+      printf("TSamuraiMagnetField::Blend() : call Blend before SetLayout, SetPlanar, SetQuantization and SetArena.\n");
+      return false;
+   }
+   TSamuraiFieldFile file;
+   if (!file.Open(fFileName.c_str())) {
+      printf("TSamuraiMagnetField::Blend() : %s is not a field container\n",
+	     fFileName.c_str());
+      return false;
+   }
+
+   /* maps on the grid of this one, ordered along the excitation curve */
+   std::vector<std::pair<double,int> > curve;
+   for (int i = 0; i != file.GetNMaps(); ++i) {
+      const TSamuraiFieldFile::Entry &e = file.GetEntry(i);
+      if (e.fNx != fNx || e.fNy != fNy || e.fNz != fNz
+	  || e.fDx != fDx || e.fDy != fDy || e.fDz != fDz
+	  || e.fX0 != fX0 || e.fY0 != fY0 || e.fZ0 != fZ0
+	  || e.fFlags != (fInfo.fFlags & ~TSamuraiFieldFile::kTiled)) {
+	 continue;
+      }
+      curve.push_back(std::make_pair(byCurrent ? e.fCurrent : e.fCentralField,i));
+   }
+   std::sort(curve.begin(),curve.end());
+   if (curve.size() < 2) {
+      printf("TSamuraiMagnetField::Blend() : needs two or more maps on the same grid.\n");
+      return false;
+   }
+
+   /* bracketing pair, or the outermost pair when extrapolating */
+   size_t hi = 1;
+   while (hi + 1 != curve.size() && curve[hi].first < value) ++hi;
+   const size_t lo = hi - 1;
+   if (curve[hi].first == curve[lo].first) {
+      printf("TSamuraiMagnetField::Blend() : two maps at %g %s\n",
+	     curve[lo].first,byCurrent ? "A" : "T");
+      return false;
+   }
+   const double t = (value - curve[lo].first) / (curve[hi].first - curve[lo].first);
+   if (t < -1e-6 || 1. + 1e-6 < t) {
+      printf("TSamuraiMagnetField::Blend() : %g %s is outside the maps, extrapolating.\n",
+	     value,byCurrent ? "A" : "T");
+   }
+
+   const TSamuraiFieldFile::Entry &ea = file.GetEntry(curve[lo].second);
+   const TSamuraiFieldFile::Entry &eb = file.GetEntry(curve[hi].second);
+   const TSamuraiMagnetField a(fFileName.c_str(),ea.fName,1.,kMmap);
+   const TSamuraiMagnetField b(fFileName.c_str(),eb.fName,1.,kMmap);
+   if (!a.IsGood() || !b.IsGood() || !a.fData || !b.fData) return false;
+
+   TSamuraiFieldFile::Entry info = fInfo;
+   info.fCurrent      = (1-t) * ea.fCurrent + t * eb.fCurrent;
+   info.fCentralField = (1-t) * ea.fCentralField + t * eb.fCentralField;
+   info.fChecksum     = TSamuraiFieldFile::Checksum(&t,sizeof(t),
+						    ea.fChecksum ^ (eb.fChecksum << 1));
+   info.fFlags       &= ~TSamuraiFieldFile::kTiled;
+   const std::string name = std::string(ea.fName) + "~" + eb.fName;
+   strncpy(info.fName,name.c_str(),sizeof(info.fName) - 1);
+   info.fName[sizeof(info.fName) - 1] = '\0';
+
+   const size_t n = (size_t)fNx * fNy * fNz * kDimension;
+   TSamuraiFieldRegistry *shared = NULL;
+   float *blend = NULL;
+   bool ready = false;
+   if (fStorage == kShared) {
+      shared = new TSamuraiFieldRegistry;
+      const std::string key =
+	 TSamuraiFieldRegistry::MakeKey(fFileName.c_str(),info.fName,
+					info.fChecksum,"node");
+      const TSamuraiFieldRegistry::EState state =
+	 shared->Attach(key,sizeof(float) * n);
+      blend = static_cast<float*>(shared->GetData());
+      if (state == TSamuraiFieldRegistry::kFailed) {
+	 delete shared;
+	 shared = NULL;
+	 blend = NULL;
+      } else if (state == TSamuraiFieldRegistry::kAttached) {
+	 ready = true; // blended by another process
+      }
+   }
+   if (!blend) blend = new float[n];
+
+   if (!ready) {
+      for (size_t i = 0; i != n; ++i) {
+	 blend[i] = (1-t) * a.fData[i] + t * b.fData[i];
+      }
+   }
+
+   ReleaseMap();
+   if (shared) {
+      if (!ready) shared->Publish();
+      fSharedMap = shared;
+   } else {
+      fBuffer  = blend;
+      fStorage = kHeap;
+   }
+   fData = blend;
+   fInfo = info;
+
+   printf("TSamuraiMagnetField::Blend() : %s (%.1f A, %.3f T) and %s (%.1f A, %.3f T), t = %.3f\n",
+	  ea.fName,ea.fCurrent,ea.fCentralField,
+	  eb.fName,eb.fCurrent,eb.fCentralField,t);
+   return true;
+}
+
+bool TSamuraiMagnetField::SetInterpolation(EInterpolation interpolation,
+					   size_t cacheSize)
+{
+   if (!IsGood()) return false;
+   delete fCubic;
+   fCubic = NULL;
+   if (interpolation == kTricubic) {
+      if (!fData) {
+	 printf("TSamuraiMagnetField::SetInterpolation() : tricubic interpolation needs the float map.\n");
+	 SelectKernel();
+	 return false;
+      }
+      /* the first plane of a mirrored axis lies on the mirror plane */
+      fCubic = new TSamuraiFieldCubic(fData,fNx,fNy,fNz,
+				      fMirrorX && fX0 == 0.,fMirrorZ && fZ0 == 0.,
+				      cacheSize ? cacheSize
+				      : TSamuraiFieldCubic::kDefaultCapacity);
+   }
+   for (int i = 0; i != kMaxLevel; ++i) {
+      if (fPyramid[i]) fPyramid[i]->SetInterpolation(interpolation,cacheSize);
+   }
+   SelectKernel();
+   return true;
+}
+
+bool TSamuraiMagnetField::SetLevel(int level)
+{
+   if (!IsGood() || level < 0 || kMaxLevel < level) return false;
+   if (level && !fPyramid[level-1]) {
+      fPyramid[level-1] = LoadLevel(level);
+      if (!fPyramid[level-1]) return false;
+      fPyramid[level-1]->fVectorISA = fVectorISA;
+      if (fCubic) {
+	 fPyramid[level-1]->SetInterpolation(kTricubic,fCubic->GetCapacity());
+      }
+   }
+   fLevel = level;
+   return true;
+}
+
+std::string TSamuraiMagnetField::LevelCacheName(int level, bool tmp) const
+{
+   std::string name = fFileName;
+   if (TSamuraiFieldFile::IsContainer(fFileName.c_str()) && *fInfo.fName) {
+      name += std::string(".") + fInfo.fName;
+   }
+   char suffix[16];
+   snprintf(suffix,sizeof(suffix),".L%d.fld",level);
+   name += suffix;
+   if (tmp) {
+      const char* const dir = getenv("TMPDIR");
+      const size_t slash = name.rfind('/');
+      name = std::string(dir && *dir ? dir : "/tmp") + "/"
+	 + (slash == std::string::npos ? name : name.substr(slash + 1));
+   }
+   return name;
+}
+
+TSamuraiMagnetField* TSamuraiMagnetField::LoadLevel(int level) const
+{
+   const int s = 1 << level;
+   TSamuraiFieldFile::Entry info = fInfo;
+   info.fNx = (fNx - 1) / s + 1;
+   info.fNy = (fNy - 1) / s + 1;
+   info.fNz = (fNz - 1) / s + 1;
+   info.fDx = fDx * s;
+   info.fDy = fDy * s;
+   info.fDz = fDz * s;
+   info.fFlags &= ~TSamuraiFieldFile::kTiled;
+   info.fSize = sizeof(float) * kDimension * info.fNx * info.fNy * info.fNz;
+   info.fOffset = 0;
+
+   /* the cached level is named after the source map */
+   uint64_t id = fInfo.fChecksum;
+   struct stat st;
+   if (!id && !stat(fFileName.c_str(),&st)) {
+      id = ((uint64_t)st.st_ino << 32) ^ st.st_size ^ st.st_mtime;
+   }
+   snprintf(info.fName,sizeof(info.fName),"L%d-%016llx",level,
+	    (unsigned long long)id);
+
+   for (int tmp = 0; tmp != 2; ++tmp) {
+      const std::string cache = LevelCacheName(level,tmp);
+      TSamuraiFieldFile file;
+      if (!file.Open(cache.c_str()) || file.FindMap(info.fName) < 0) continue;
+      TSamuraiMagnetField *const field =
+	 new TSamuraiMagnetField(cache.c_str(),info.fName,1.,kMmap);
+      if (field->IsGood()) {
+	 printf("TSamuraiMagnetField::SetLevel() : level %d loaded from %s\n",
+		level,cache.c_str());
+	 return field;
       }
+      delete field;
    }
 
-   fField          = new float***[fNx];
-   fField[0]       = new float** [fNx*fNy];
-   fField[0][0]    = new float*  [fNx*fNy*fNz];
-   fField[0][0][0] = new float   [fNx*fNy*fNz*kDimension];
+   if (!fData) {
+      printf("TSamuraiMagnetField::SetLevel() : needs the float map to build level %d.\n",
+	     level);
+      return NULL;
+   }
+   if ((fNy - 1) % (2 * s) || info.fNy < 3) {
+      printf("TSamuraiMagnetField::SetLevel() : level %d has no midplane.\n",level);
+      return NULL;
+   }
+
+   float *const data = new float[info.fSize / sizeof(float)];
+   float *dst = data;
+   for (int i = 0; i != info.fNx; ++i) {
+      for (int j = 0; j != info.fNy; ++j) {
+	 for (int k = 0; k != info.fNz; ++k, dst += kDimension) {
+	    std::copy(Node(i * s,j * s,k * s),Node(i * s,j * s,k * s) + kDimension,dst);
+	 }
+      }
+   }
+
+   std::vector<TSamuraiFieldFile::Entry> entries(1,info);
+   std::vector<const void*> payload(1,data);
+   for (int tmp = 0; tmp != 2; ++tmp) {
+      const std::string cache = LevelCacheName(level,tmp);
+      if (TSamuraiFieldFile::Write(cache.c_str(),entries,payload)) {
+	 printf("TSamuraiMagnetField::SetLevel() : level %d (%dx%dx%d) cached in %s\n",
+		level,info.fNx,info.fNy,info.fNz,cache.c_str());
+	 break;
+      }
+   }
+   return new TSamuraiMagnetField(info,data);
+}
+
+bool TSamuraiMagnetField::SetArena(TSamuraiFieldArena::EPages pages,
+				   bool replicate)
+{
+   if (!IsGood()) return false;
+   if (fTiles || fQuantization != kFloat) {
+      printf("TSamuraiMagnetField::SetArena() : needs the float map.\n");
+      return false;
+   }
+
+   const bool cells = (fLayout == kCellMajor);
+   const float *const src = cells ? fCells : fData;
+   const size_t size = cells
+      ? sizeof(float) * kCellSize * (fNx-1) * (fNy-1) * (fNz-1)
+      : sizeof(float) * kDimension * fNx * fNy * fNz;
+   const int nReplica = replicate ? TSamuraiFieldArena::GetNumNodes() : 1;
+
+   TSamuraiFieldArena *const arena = new TSamuraiFieldArena;
+   std::vector<float*> replicas;
+   for (int node = 0; node != nReplica; ++node) {
+      char label[64];
+      snprintf(label,sizeof(label),"%s map, replica %d",
+	       cells ? "cell-major" : "node-major",node);
+      float *const dst = static_cast<float*>
+	 (arena->Allocate(size,pages,replicate ? node : -1,label));
+      if (!dst) {
+	 delete arena;
+	 return false;
+      }
+      memcpy(dst,src,size);
+      replicas.push_back(dst);
+   }
+
+   /* drop the previous storage of the copied array */
+   if (cells) {
+      ReleaseCells();
+      fCells = replicas[0];
+   } else {
+      ReleaseMap();
+      fData = replicas[0];
+   }
+   fArena = arena;
+   fReplicas.swap(replicas);
+   fArena->Report();
+   return true;
+}
+
+int TSamuraiMagnetField::Replica() const
+{
+   return TSamuraiFieldArena::GetThreadNode() % fReplicas.size();
+}
+
+namespace {
+   /* IEEE 754 binary16 <-> binary32 */
+   inline uint32_t FloatBits(float f)
+   {
+      uint32_t u;
+      memcpy(&u,&f,sizeof(u));
+      return u;
+   }
+
+   inline float BitsFloat(uint32_t u)
+   {
+      float f;
+      memcpy(&f,&u,sizeof(f));
+      return f;
+   }
+
+   uint16_t FloatToHalf(float f)
+   {
+      const uint32_t u = FloatBits(f);
+      const uint16_t sign = (u >> 16) & 0x8000;
+      const int32_t  exp  = ((u >> 23) & 0xff) - 127 + 15;
+      uint32_t mant = u & 0x7fffff;
+
+      if (((u >> 23) & 0xff) == 0xff) {        // inf / nan
+	 return sign | 0x7c00 | (mant ? 0x200 : 0);
+      }
+      if (exp >= 0x1f) return sign | 0x7c00;   // overflow
+      if (exp <= 0) {                           // subnormal or zero
+	 if (exp < -10) return sign;
+	 mant |= 0x800000;
+	 const int shift = 14 - exp;
+	 uint32_t half = mant >> shift;
+	 if ((mant >> (shift - 1)) & 1) ++half; // round half up
+	 return sign | half;
+      }
+      uint32_t half = sign | (exp << 10) | (mant >> 13);
+      if (mant & 0x1000) ++half;                // round half up
+      return half;
+   }
+
+   inline float HalfToFloat(uint16_t h)
+   {
+      const uint32_t sign = (uint32_t)(h & 0x8000) << 16;
+      const uint32_t exp  = (h >> 10) & 0x1f;
+      const uint32_t mant = h & 0x3ff;
+
+      if (exp == 0) {                           // subnormal or zero
+	 const float f = mant * (1.f / (1 << 24));
+	 return sign ? -f : f;
+      }
+      if (exp == 0x1f) return BitsFloat(sign | 0x7f800000 | (mant << 13));
+      return BitsFloat(sign | ((exp + 127 - 15) << 23) | (mant << 13));
+   }
+}
+
+bool TSamuraiMagnetField::SetQuantization(EQuantization quantization)
+{
+   if (!IsGood() || quantization == fQuantization) return IsGood();
+   if (!fData || fLayout != kNodeMajor) {
+      printf("TSamuraiMagnetField::SetQuantization() : needs the node-major float map.\n");
+      return false;
+   }
+
+   const size_t nNode = (size_t)fNx * fNy * fNz;
+   fQuant = new uint16_t[nNode * kDimension];
+   fQuantization = quantization;
+
+   if (quantization == kInt16) {
+      const size_t nBrick = Brick(fNx - 1,fNy - 1,fNz - 1) / kDimension + 1;
+      fQuantOffset = new float[nBrick * kDimension];
+      fQuantScale  = new float[nBrick * kDimension];
+      std::vector<float> vmax(nBrick * kDimension,-HUGE_VALF);
+      std::fill(fQuantOffset,fQuantOffset + nBrick * kDimension,HUGE_VALF);
+
+      for (int i = 0; i != fNx; ++i) {
+	 for (int j = 0; j != fNy; ++j) {
+	    for (int k = 0; k != fNz; ++k) {
+	       const float *const f = Node(i,j,k);
+	       const size_t b = Brick(i,j,k);
+	       for (int axis = 0; axis != kDimension; ++axis) {
+		  fQuantOffset[b + axis] = std::min(fQuantOffset[b + axis],f[axis]);
+		  vmax[b + axis] = std::max(vmax[b + axis],f[axis]);
+	       }
+	    }
+	 }
+      }
+      for (size_t b = 0; b != nBrick * kDimension; ++b) {
+	 fQuantScale[b] = (vmax[b] - fQuantOffset[b]) / 65535.f;
+      }
+   }
+
+   /* encode and measure the worst-case error */
+   fQuantizationError = 0.;
    for (int i = 0; i != fNx; ++i) {
-      fField[i] = fField[0] + i * fNy;
       for (int j = 0; j != fNy; ++j) {
-	 fField[i][j] = fField[0][0] + i * fNy * fNz + j * fNz;
 	 for (int k = 0; k != fNz; ++k) {
-	    fField[i][j][k] =
-	       fField[0][0][0]
-	       + i * fNy * fNz * kDimension
-	       + j       * fNz * kDimension
-	       + k             * kDimension;
+	    const float *const f = Node(i,j,k);
+	    const size_t node = f - fData;
+	    for (int axis = 0; axis != kDimension; ++axis) {
+	       if (quantization == kHalf) {
+		  fQuant[node + axis] = FloatToHalf(f[axis]);
+	       } else {
+		  const size_t b = Brick(i,j,k) + axis;
+		  fQuant[node + axis] = fQuantScale[b] > 0.f
+		     ? (uint16_t)floor((f[axis] - fQuantOffset[b])
+				       / fQuantScale[b] + 0.5)
+		     : 0;
+	       }
+	       const double err = fabs(Decode(node + axis,i,j,k,axis) - f[axis]);
+	       fQuantizationError = std::max(fQuantizationError,err);
+	    }
 	 }
       }
    }
-   ifs.read((char*)(fField[0][0][0]), expectedFileSize);
 
-   fIsGood = true;
+   ReleaseMap();
+   SelectKernel();
+
+   printf("TSamuraiMagnetField::SetQuantization() : %s, %lu MB, max error = %.3g T\n",
+	  quantization == kHalf ? "half" : "int16",
+	  sizeof(uint16_t) * nNode * kDimension >> 20,fQuantizationError);
+   return true;
 }
 
-TSamuraiMagnetField::~TSamuraiMagnetField()
+float TSamuraiMagnetField::Decode(size_t node, int i, int j, int k,
+				  int axis) const
+{
+   if (fQuantization == kHalf) return HalfToFloat(fQuant[node]);
+
+   const size_t b = Brick(i,j,k) + axis;
+   return fQuantOffset[b] + fQuantScale[b] * fQuant[node];
+}
+
+void TSamuraiMagnetField::DecodeCorners(int i, int j, int k, float *c) const
+{
+   for (int n = 0; n != kCorner; ++n) {
+      const int ii = i + (n >> 2);
+      const int jj = j + ((n >> 1) & 1);
+      const int kk = k + (n & 1);
+      const size_t node = ii * fStrideX + jj * fStrideY + kk * kDimension;
+      for (int axis = 0; axis != kDimension; ++axis) {
+	 c[n * kDimension + axis] = Decode(node + axis,ii,jj,kk,axis);
+      }
+   }
+}
+
+namespace {
+   inline void DivRem(double x, double y, int *div, double *rem) {
+      *div = floor(x/y);
+      *rem = x - (*div) * y;
+   }
+}
+
+bool TSamuraiMagnetField::SetPlanar(bool planar)
 {
-   if(fField) {
-      delete [] fField[0][0][0];
-      delete [] fField[0][0];
-      delete [] fField[0];
-      delete [] fField;
-      fField = NULL;
+   delete [] fMidplane;
+   fMidplane = NULL;
+   if (!planar || !IsGood()) return IsGood();
+   if (!fData) {
+      printf("TSamuraiMagnetField::SetPlanar() : float map already released.\n");
+      return false;
+   }
+
+   const double jMid = - fY0 / fDy;
+   const int j = (int)floor(jMid + 0.5);
+   if (fabs(jMid - j) > 1e-9 || j < 0 || fNy <= j) {
+      printf("TSamuraiMagnetField::SetPlanar() : No grid plane at y = 0.\n");
+      return false;
+   }
+
+   fMidplane = new float[(size_t)fNx * fNz];
+   for (int i = 0; i != fNx; ++i) {
+      for (int k = 0; k != fNz; ++k) {
+	 fMidplane[(size_t)i * fNz + k] = Node(i,j,k)[1];
+      }
    }
+
+   printf("TSamuraiMagnetField::SetPlanar() : midplane slice %dx%d (%lu kB)\n",
+	  fNx,fNz,sizeof(float) * fNx * fNz >> 10);
+   return true;
+}
+
+bool TSamuraiMagnetField::EvalMidplane(double x, double z, double *by) const
+{
+   int i, k;
+   double p, r;
+   DivRem((fMirrorX ? fabs(x) : x) - fX0,fDx,&i,&p);
+   DivRem((fMirrorZ ? fabs(z) : z) - fZ0,fDz,&k,&r);
+   if (i < 0 || fNx - 1 <= i || k < 0 || fNz - 1 <= k) return false;
+   p /= fDx;
+   r /= fDz;
+
+   /* bilinear interpolation */
+   const float *const f0 = fMidplane + (size_t)i * fNz + k;
+   const float *const f1 = f0 + fNz;
+   const double c0 = (1-p)*f0[0] + p*f1[0];
+   const double c1 = (1-p)*f0[1] + p*f1[1];
+   *by = fScale * ((1-r)*c0 + r*c1);
+   return true;
+}
+
+bool TSamuraiMagnetField::GetBounds(double min[3], double max[3]) const
+{
+   if (fLevel) return fPyramid[fLevel-1]->GetBounds(min,max);
+   if (!fIsGood) return false;
+
+   const double x1 = fX0 + fDx * (fNx - 1);
+   const double z1 = fZ0 + fDz * (fNz - 1);
+   min[0] = fMirrorX ? -std::max(fabs(fX0),fabs(x1)) : fX0;
+   max[0] = fMirrorX ?  std::max(fabs(fX0),fabs(x1)) : x1;
+   min[1] = fY0;
+   max[1] = fY0 + fDy * (fNy - 1);
+   min[2] = fMirrorZ ? -std::max(fabs(fZ0),fabs(z1)) : fZ0;
+   max[2] = fMirrorZ ?  std::max(fabs(fZ0),fabs(z1)) : z1;
+   return true;
 }
 
 void TSamuraiMagnetField::Eval(double x, double y, double z,
 			       double *bx, double *by, double *bz) const
 {
+   if (fLevel) {
+      fPyramid[fLevel-1]->Eval(x,y,z,bx,by,bz);
+      *bx *= fScale;
+      *by *= fScale;
+      *bz *= fScale;
+      return;
+   }
+
+#ifdef SAMURAI_FIELD_STATS
+   Record(x,y,z);
+#endif
+
+   if (fMidplane && !fCubic && fabs(y) <= kPlanarTolerance) {
+      *bx = 0;
+      *bz = 0;
+      if (!EvalMidplane(x,z,by)) *by = 0;
+      return;
+   }
+
+   if (fKernel) {
+      double b[kDimension];
+      if (!fKernel(fReplicas.size() > 1 ? fReplicas[Replica()] : fData,
+		   x,y,z,b)) {
+	 b[0] = b[1] = b[2] = 0;
+      }
+      *bx = fScale * b[0];
+      *by = fScale * b[1];
+      *bz = fScale * b[2];
+      return;
+   }
+
    int i,j,k;    // identifiers of the cell
    double p,q,r; // local coordinate in the cell
 
@@ -102,21 +1010,165 @@ void TSamuraiMagnetField::Eval(double x, double y, double z,
    Interpolate(i,j,k,p,q,r,bx,by,bz);
 }
 
-namespace {
-   inline void DivRem(double x, double y, int *div, double *rem) {
-      *div = x/y;
-      *rem = x - (*div) * y;
+void TSamuraiMagnetField::EvalN(size_t n, const double x[], const double y[],
+				const double z[],
+				double bx[], double by[], double bz[]) const
+{
+   EvalBatch<TDoublePrecision>(n,x,y,z,bx,by,bz);
+}
+
+void TSamuraiMagnetField::EvalN(size_t n, const float x[], const float y[],
+				const float z[],
+				float bx[], float by[], float bz[]) const
+{
+   EvalBatch<TSinglePrecision>(n,x,y,z,bx,by,bz);
+}
+
+template <class Precision>
+void TSamuraiMagnetField::EvalBatch(size_t n,
+				    const typename Precision::Real_t x[],
+				    const typename Precision::Real_t y[],
+				    const typename Precision::Real_t z[],
+				    typename Precision::Real_t bx[],
+				    typename Precision::Real_t by[],
+				    typename Precision::Real_t bz[]) const
+{
+   typedef typename Precision::Real_t Real;
+   if (fLevel) {
+      fPyramid[fLevel-1]->EvalBatch<Precision>(n,x,y,z,bx,by,bz);
+      for (size_t i = 0; i != n; ++i) {
+	 bx[i] *= fScale;
+	 by[i] *= fScale;
+	 bz[i] *= fScale;
+      }
+      return;
+   }
+
+   /* gathers take 32-bit indices */
+   const size_t nFloat = fStrideX * fNx;
+   if (fVectorISA == kScalar || !fData || fTiles || fMidplane || fCubic
+       || fQuantization != kFloat || fLayout != kNodeMajor
+       || nFloat > 0x7fffffffUL) {
+      for (size_t i = 0; i != n; ++i) {
+	 double b[kDimension];
+	 Eval(x[i],y[i],z[i],b,b+1,b+2);
+	 bx[i] = (Real)b[0];
+	 by[i] = (Real)b[1];
+	 bz[i] = (Real)b[2];
+      }
+      return;
+   }
+
+#ifdef SAMURAI_FIELD_STATS
+   for (size_t i = 0; i != n; ++i) Record(x[i],y[i],z[i]);
+#endif
+
+   TSamuraiFieldSimd::Grid grid;
+   grid.fData = fReplicas.size() > 1 ? fReplicas[Replica()] : fData;
+   grid.fNx = fNx;
+   grid.fNy = fNy;
+   grid.fNz = fNz;
+   grid.fDx = fDx;
+   grid.fDy = fDy;
+   grid.fDz = fDz;
+   grid.fX0 = fX0;
+   grid.fY0 = fY0;
+   grid.fZ0 = fZ0;
+   grid.fMirrorX = fMirrorX;
+   grid.fMirrorZ = fMirrorZ;
+   grid.fStrideX = fStrideX;
+   grid.fStrideY = fStrideY;
+   grid.fScale = fScale;
+
+   /* the overloads of Precision::Real_t */
+   size_t done = fVectorISA == kAVX512
+      ? TSamuraiFieldSimd::EvalAVX512(grid,n,x,y,z,bx,by,bz)
+      : TSamuraiFieldSimd::EvalAVX2(grid,n,x,y,z,bx,by,bz);
+
+   /* remainder by the generic path, which the double kernels reproduce */
+   for (; done != n; ++done) {
+      int i,j,k;
+      double p,q,r;
+      double b[kDimension];
+      if (!FindCell(x[done],y[done],z[done],&i,&j,&k,&p,&q,&r)) {
+	 bx[done] = by[done] = bz[done] = 0;
+	 continue;
+      }
+      Interpolate(i,j,k,p,q,r,b,b+1,b+2);
+      bx[done] = (Real)b[0];
+      by[done] = (Real)b[1];
+      bz[done] = (Real)b[2];
+   }
+}
+
+void TSamuraiMagnetField::EvalWithGradient(double x, double y, double z,
+					   double b[3], double grad[3][3]) const
+{
+   if (fLevel) {
+      fPyramid[fLevel-1]->EvalWithGradient(x,y,z,b,grad);
+      for (int axis = 0; axis != kDimension; ++axis) {
+	 b[axis] *= fScale;
+	 for (int n = 0; n != kDimension; ++n) grad[axis][n] *= fScale;
+      }
+      return;
+   }
+
+   int i,j,k;
+   double p,q,r;
+   double d[kDimension][kDimension];
+   bool inside = FindCell(x,y,z,&i,&j,&k,&p,&q,&r);
+#ifdef SAMURAI_FIELD_STATS
+   Record(inside,i,j,k);
+#endif
+   if (inside) {
+      if (fCubic) {
+	 fCubic->EvalWithGradient(i,j,k,p,q,r,b,d);
+      } else {
+	 inside = InterpolateGradient(i,j,k,p,q,r,b,d);
+      }
+   }
+   if (!inside) {
+      for (int axis = 0; axis != kDimension; ++axis) {
+	 b[axis] = 0;
+	 for (int n = 0; n != kDimension; ++n) grad[axis][n] = 0;
+      }
+      return;
+   }
+
+   /* local coordinate -> position, with d|x|/dx = -1 for x < 0 */
+   const double unit[kDimension] = {
+      (fMirrorX && x < 0 ? -1. : 1.) / fDx,
+      1. / fDy,
+      (fMirrorZ && z < 0 ? -1. : 1.) / fDz,
+   };
+   for (int axis = 0; axis != kDimension; ++axis) {
+      b[axis] = fScale * b[axis];
+      for (int n = 0; n != kDimension; ++n) {
+	 grad[axis][n] = fScale * d[axis][n] * unit[n];
+      }
    }
 }
 
+void TSamuraiMagnetField::Record(bool inside, int i, int j, int k) const
+{
+   if (fStats) fStats->Record(inside,i,j,k);
+}
+
+void TSamuraiMagnetField::Record(double x, double y, double z) const
+{
+   int i,j,k;
+   double p,q,r;
+   const bool inside = FindCell(x,y,z,&i,&j,&k,&p,&q,&r);
+   Record(inside,i,j,k);
+}
+
 bool TSamuraiMagnetField::FindCell(double x, double y, double z,
 				     int *i, int *j, int *k,
 				     double *p, double *q, double *r) const
 {
-   DivRem(fabs(x),fDx,i,p); // x is symmetric
-   DivRem(y,fDy,j,q);             // y is not symmetric
-   *j += (fNy / 2);                     // shift y index by half of fNy
-   DivRem(fabs(z),fDz,k,r); // z is symmetric
+   DivRem((fMirrorX ? fabs(x) : x) - fX0,fDx,i,p); // x is symmetric
+   DivRem(y - fY0,fDy,j,q);                        // y is not symmetric
+   DivRem((fMirrorZ ? fabs(z) : z) - fZ0,fDz,k,r); // z is symmetric
 
    *p /= fDx;
    *q /= fDy;
@@ -130,18 +1182,85 @@ bool TSamuraiMagnetField::FindCell(double x, double y, double z,
 	   && (0 <= *k) && (*k < fNz - 1));
 }
 
+void TSamuraiMagnetField::Corners(const float *data, int i, int j, int k,
+				  const float *f[kCorner]) const
+{
+   /* corner n = (di << 2) | (dj << 1) | dk */
+   f[0] = data + i * fStrideX + j * fStrideY + k * kDimension;
+   f[1] = f[0] + kDimension;
+   f[2] = f[0] + fStrideY;
+   f[3] = f[2] + kDimension;
+   f[4] = f[0] + fStrideX;
+   f[5] = f[4] + kDimension;
+   f[6] = f[4] + fStrideY;
+   f[7] = f[6] + kDimension;
+}
+
+bool TSamuraiMagnetField::CellCorners(int i, int j, int k,
+				      const float *f[kCorner],
+				      float decoded[kCellSize]) const
+{
+   if (fTiles) {
+      return fTiles->Corners(i,j,k,f);
+   } else if (fQuantization != kFloat) {
+      DecodeCorners(i,j,k,decoded);
+      for (int n = 0; n != kCorner; ++n) f[n] = decoded + n * kDimension;
+   } else if (fLayout == kCellMajor) {
+      const float *const cell =
+	 (fReplicas.size() > 1 ? fReplicas[Replica()] : fCells) + Cell(i,j,k);
+      for (int n = 0; n != kCorner; ++n) f[n] = cell + n * kDimension;
+   } else {
+      Corners(fReplicas.size() > 1 ? fReplicas[Replica()] : fData,i,j,k,f);
+   }
+   return true;
+}
+
+void TSamuraiMagnetField::PrefetchCell(int i, int j, int k) const
+{
+   if (fTiles || fQuantization != kFloat) return;
+   if (fLayout == kCellMajor) {
+      const float *const cell =
+	 (fReplicas.size() > 1 ? fReplicas[Replica()] : fCells) + Cell(i,j,k);
+      __builtin_prefetch(cell);
+      __builtin_prefetch(cell + kCellSize - 1);
+      return;
+   }
+   /* corners (di,dj,0) and (di,dj,1) are adjacent: 4 runs of 24 bytes */
+   const float *f[kCorner];
+   Corners(fReplicas.size() > 1 ? fReplicas[Replica()] : fData,i,j,k,f);
+   for (int n = 0; n != kCorner; n += 2) {
+      __builtin_prefetch(f[n]);
+      __builtin_prefetch(f[n] + 2 * kDimension - 1);
+   }
+}
+
 void TSamuraiMagnetField::Interpolate(int i, int j, int k,
 				      double p, double q, double r,
 				      double *bx, double *by, double *bz) const
 {
    double c[3];
 
+   if (fCubic) {
+      fCubic->Eval(i,j,k,p,q,r,c);
+      *bx = fScale * c[0];
+      *by = fScale * c[1];
+      *bz = fScale * c[2];
+      return;
+   }
+
+   const float *f[kCorner];
+   float decoded[kCellSize];
+   if (!CellCorners(i,j,k,f,decoded)) {
+      *bx = *by = *bz = 0;
+      return;
+   }
+
    /* trilinear interpolation */
    for (size_t axis = 0; axis != kDimension; ++axis) {
-      const double c00 = (1-p)*fField[i][j][k][axis]     + p*fField[i+1][j][k][axis];
-      const double c01 = (1-p)*fField[i][j][k+1][axis]   + p*fField[i+1][j][k+1][axis];
-      const double c10 = (1-p)*fField[i][j+1][k][axis]   + p*fField[i+1][j+1][k][axis];
-      const double c11 = (1-p)*fField[i][j+1][k+1][axis] + p*fField[i+1][j+1][k+1][axis];
+      const double c00 = (1-p)*f[0][axis] + p*f[4][axis];
+      const double c01 = (1-p)*f[1][axis] + p*f[5][axis];
+      const double c10 = (1-p)*f[2][axis] + p*f[6][axis];
+      const double c11 = (1-p)*f[3][axis] + p*f[7][axis];
 
       const double c0 = (1-q)*c00 + q*c10;
       const double c1 = (1-q)*c01 + q*c11;
@@ -154,8 +1273,32 @@ void TSamuraiMagnetField::Interpolate(int i, int j, int k,
    *bz = fScale * c[2];
 }
 
-double TSamuraiMagnetField::GetCentralField()
+bool TSamuraiMagnetField::InterpolateGradient(int i, int j, int k,
+					      double p, double q, double r,
+					      double b[kDimension],
+					      double d[kDimension][kDimension]) const
 {
-   // returns B(upward) at magnet center
-   return IsGood() ? fField[0][fNy/2][0][1] * fScale : 0.;
+   const float *f[kCorner];
+   float decoded[kCellSize];
+   if (!CellCorners(i,j,k,f,decoded)) return false;
+
+   /* trilinear interpolation as in Interpolate, and its derivatives */
+   for (size_t axis = 0; axis != kDimension; ++axis) {
+      const double c00 = (1-p)*f[0][axis] + p*f[4][axis];
+      const double c01 = (1-p)*f[1][axis] + p*f[5][axis];
+      const double c10 = (1-p)*f[2][axis] + p*f[6][axis];
+      const double c11 = (1-p)*f[3][axis] + p*f[7][axis];
+
+      const double c0 = (1-q)*c00 + q*c10;
+      const double c1 = (1-q)*c01 + q*c11;
+
+      b[axis] = (1-r)*c0 + r*c1;
+
+      const double d0 = (1-q)*(f[4][axis] - f[0][axis]) + q*(f[6][axis] - f[2][axis]);
+      const double d1 = (1-q)*(f[5][axis] - f[1][axis]) + q*(f[7][axis] - f[3][axis]);
+      d[axis][0] = (1-r)*d0 + r*d1;
+      d[axis][1] = (1-r)*(c10 - c00) + r*(c11 - c01);
+      d[axis][2] = c1 - c0;
+   }
+   return true;
 }
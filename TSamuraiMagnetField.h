@@ -12,8 +12,21 @@
 #ifndef INCLUDE_GUARD_UUID_5DCC58A8_96F9_4CD7_8978_28232C6B0F3B
 #define INCLUDE_GUARD_UUID_5DCC58A8_96F9_4CD7_8978_28232C6B0F3B
 
+#include "TMagneticField.h"
+#include "TSamuraiFieldFile.h"
+#include "TSamuraiFieldArena.h"
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
 namespace art {
    class TSamuraiMagnetField;
+   class TSamuraiFieldTiles;
+   class TSamuraiFieldRegistry;
+   class TSamuraiFieldCursor;
+   class TSamuraiFieldCubic;
+   class TSamuraiFieldStats;
 }
 
 ////////////////////////////////////////////////////////////
@@ -21,39 +34,276 @@ namespace art {
 /// coordinate => x: beam left, y: upward, z: downstream
 /// (the same definition as H.Sato san's field calculation)
 ///
+/// The map is held as one flat array indexed by strides
+/// ([fNx][fNy][fNz][kDimension], z fastest). With kMmap the file is
+/// mapped read-only and pages are faulted in from the page cache on
+/// first access, so construction costs one open/mmap regardless of
+/// the map size and concurrent processes share the same pages.
+///
+/// SetLayout(kCellMajor) additionally builds a copy in which the 8
+/// corners x 3 components of every cell are packed next to each other
+/// (96 bytes, i.e. one or two cache lines per lookup). This costs about
+/// 8 times the memory of the node-major map (~690 MB for 301x81x301).
+///
+/// SetPlanar(true) extracts By on the midplane (y = 0) into a small
+/// nx x nz table. Points within kPlanarTolerance of the midplane are
+/// then evaluated by bilinear interpolation in that table with
+/// Bx = Bz = 0 (they vanish on the midplane by symmetry); any other
+/// point falls back to the 3D map.
+///
+/// SetQuantization() re-encodes the map as 16-bit values, either IEEE
+/// half floats (kHalf) or unsigned integers with a scale and offset per
+/// brick of kBrick^3 nodes and component (kInt16), and releases the
+/// float map. Values are decoded in Interpolate. The worst-case
+/// absolute error against the float map is reported and kept in
+/// GetQuantizationError().
+///
+/// With kShared the map is read once per node into a POSIX shared
+/// memory segment (see TSamuraiFieldRegistry) that later processes
+/// attach read-only; a cell-major copy is shared the same way.
+///
+/// SetArena() moves the array Eval reads (the cell-major copy if
+/// present, the node-major map otherwise) into a TSamuraiFieldArena on
+/// small, transparent huge or explicit huge pages. With replicate, one
+/// copy is placed on each NUMA node and every thread reads the copy of
+/// the node it is bound to (TSamuraiFieldArena::BindThread()). Call it
+/// after SetLayout(); it gives up the sharing of kMmap and kShared.
+///
+/// BlendToCurrent() / BlendToCentralField() replace the map by one for
+/// an off-nominal excitation, interpolated linearly along the
+/// excitation curve between the two container maps (same grid) whose
+/// nominal current or central field bracket the requested value. This
+/// follows yoke saturation where SetScale() would not. The blend is
+/// computed once into a heap map (or a shared segment with kShared)
+/// and has to precede the operations above.
+///
+/// SetLevel(L) switches Eval to a coarse level of a pyramid made of
+/// every 2^L-th node (20, 40 and 80 mm for L = 1..3 on the 10 mm map);
+/// SetLevel(0) returns to the full map. A level is built once from the
+/// float map and cached as a container "<file>[.<map>].L<L>.fld" next
+/// to the map (or in $TMPDIR), so later runs load it without touching
+/// the full map.
+///
+/// Eval of a node-major float map on a grid known at compile time (the
+/// SAMURAI 301x81x301 @ 10 mm) is dispatched to a TSamuraiFieldGrid
+/// instantiation; SetGeneric(true) forces the generic path.
+///
+/// SetInterpolation(kTricubic) interpolates with tricubic Catmull-Rom
+/// splines instead of trilinearly (see TSamuraiFieldCubic), so the
+/// field is smooth across cell faces and the tracer may take longer
+/// steps. The coefficients are computed per cell on first use and
+/// cached. It needs the float map and has to follow the operations
+/// above; anything releasing the float map falls back to trilinear.
+///
+/// EvalWithGradient() returns B and its 3x3 gradient from one cell
+/// lookup, differentiating the interpolation in use; this replaces six
+/// extra Eval() calls of finite differences. The midplane slice and the
+/// fixed-grid kernel are not used for it.
+///
+/// EvalN() evaluates a batch of points. On a node-major float map it
+/// runs the AVX-512 or AVX2 kernel of TSamuraiFieldSimd (chosen at
+/// construction from what the CPU supports, see SetVectorISA()) and
+/// finishes the remainder with the scalar generic path; otherwise it
+/// loops over Eval(). The vector kernels repeat the generic arithmetic
+/// operation by operation, so EvalN() agrees with Eval() under
+/// SetGeneric(true) bit for bit. The fixed-grid kernel multiplies by
+/// the inverse mesh instead of dividing, so against it the results
+/// differ by rounding only (|dB| < 1e-14 T on the SAMURAI map).
+/// The float overload of EvalN() runs the single precision kernels (8
+/// or 16 points per vector) and is accurate to float rounding.
+///
+/// Compiled with SAMURAI_FIELD_STATS, every lookup through Eval(),
+/// EvalN(), EvalWithGradient() and TSamuraiFieldCursor is recorded in a
+/// TSamuraiFieldStats (GetStats()): cells read, lookups out of the
+/// domain and pages touched. Without it GetStats() returns NULL and the
+/// lookups are not instrumented. A pyramid level keeps its own
+/// statistics; GetStats() returns those of the level evaluated.
+///
+/// A container entry flagged kTiled is not loaded at all: its tiles are
+/// decompressed on demand into a bounded LRU cache (kTiled storage, see
+/// TSamuraiFieldTiles), so resident memory follows the region actually
+/// traced. The operations above need the float map and are not
+/// available for tiled maps.
+///
+/// filename may be a legacy raw float dump, whose geometry is given by
+/// nx..dz, or a TSamuraiFieldFile container, whose geometry, symmetry
+/// and nominal excitation are taken from the selected TOC entry.
+///
 
-class art::TSamuraiMagnetField {
+class art::TSamuraiMagnetField : public TMagneticField {
+   friend class TSamuraiFieldCursor;
 public:
+   enum EStorage { kHeap, kMmap, kShared, kTiled };
+   enum ELayout  { kNodeMajor, kCellMajor };
+   enum EQuantization { kFloat, kHalf, kInt16 };
+   enum EVectorISA { kScalar, kAVX2, kAVX512 };
+   enum EInterpolation { kTrilinear, kTricubic };
+   static const int kMaxLevel = 3; // coarsest pyramid level
+
    TSamuraiMagnetField(const char* filename, double scale = 1.,
 		       int nx = 301, int ny = 81, int nz = 301,
-		       double dx = 10, double dy = 10, double dz = 10);
+		       double dx = 10, double dy = 10, double dz = 10,
+		       EStorage storage = kMmap);
+   TSamuraiMagnetField(const char* filename, const char* mapName,
+		       double scale = 1., EStorage storage = kMmap);
    virtual ~TSamuraiMagnetField();
 
    void Eval(double x, double y, double z,
 	     double *bx, double *by, double *bz) const;
+   // B and grad[i][j] = dB_i/dx_j (T/mm) from the same cell. On a
+   // mirrored axis the map is evaluated at |x|, so the derivatives along
+   // it change sign for x < 0 (x = 0 is taken from the positive side)
+   void EvalWithGradient(double x, double y, double z,
+			 double b[3], double grad[3][3]) const;
+   void EvalN(size_t n, const double x[], const double y[], const double z[],
+	      double bx[], double by[], double bz[]) const;
+   // single precision batch (TSinglePrecision): twice the vector width
+   void EvalN(size_t n, const float x[], const float y[], const float z[],
+	      float bx[], float by[], float bz[]) const;
    double GetScale() const {return fScale;}
    void SetScale(double scale) {fScale = scale;};
-   void ResetScale() {fScale = 1.;};
-   double GetCentralField();
    bool IsGood() const {return fIsGood;};
+   // cells of the level evaluated, mirrored halves included
+   bool GetBounds(double min[3], double max[3]) const;
+   EStorage GetStorage() const {return fStorage;}
+   TSamuraiFieldTiles* GetTiles() const {return fTiles;}
+   bool SetLayout(ELayout layout);
+   ELayout GetLayout() const {return fLayout;}
+   bool SetPlanar(bool planar = true);
+   bool IsPlanar() const {return fMidplane != NULL;}
+   bool SetQuantization(EQuantization quantization);
+   EQuantization GetQuantization() const {return fQuantization;}
+   double GetQuantizationError() const {return fQuantizationError;}
+   bool SetArena(TSamuraiFieldArena::EPages pages, bool replicate = false);
+   bool BlendToCurrent(double current) {return Blend(true,current);}
+   bool BlendToCentralField(double field) {return Blend(false,field);}
+   void SetGeneric(bool generic) {fGeneric = generic; SelectKernel();}
+   bool IsSpecialized() const {return fKernel != NULL;}
+   // false if the CPU lacks the instruction set
+   bool SetVectorISA(EVectorISA isa);
+   EVectorISA GetVectorISA() const {return fVectorISA;}
+   // cacheSize: cells with tricubic coefficients (0: default)
+   bool SetInterpolation(EInterpolation interpolation, size_t cacheSize = 0);
+   EInterpolation GetInterpolation() const
+   {return fCubic ? kTricubic : kTrilinear;}
+   TSamuraiFieldCubic* GetCubic() const {return fCubic;}
+   bool SetLevel(int level);
+   int GetLevel() const {return fLevel;}
+   // fault in the pages of a mapped map ahead of the first lookups
+   void Prefetch() const;
+   const TSamuraiFieldArena* GetArena() const {return fArena;}
+   // name, nominal current/central field and checksum of the map
+   const TSamuraiFieldFile::Entry& GetInfo() const {return fInfo;}
+   // NULL unless compiled with SAMURAI_FIELD_STATS
+   TSamuraiFieldStats* GetStats() const
+   {return fLevel ? fPyramid[fLevel-1]->fStats : fStats;}
 
 private:
    static const int kDimension = 3; // = Bx, By, Bz
-   float    ****fField;             // [kDimension][fNx][fNy][fNz]
-   const int    fNx;                // number of x grid
-   const int    fNy;                // number of y grid
-   const int    fNz;                // number of z grid
-   const double fDx;                // mesh size x
-   const double fDy;                // mesh size y
-   const double fDz;                // mesh size z
+   static const int kCorner    = 8; // corners of a cell
+   static const int kCellSize  = kCorner * kDimension;
+   static const double kPlanarTolerance; // mm
+   static const int kBrickShift = 3;     // kInt16 brick = 8^3 nodes
+   static const int kBrick      = 1 << kBrickShift;
+   const float *fData;              // [fNx][fNy][fNz][kDimension]
+   float       *fBuffer;            // owned heap storage (kHeap)
+   void        *fMapAddress;        // mapped region (kMmap)
+   size_t       fMapLength;         // length of mapped region
+   EStorage     fStorage;
+   ELayout      fLayout;
+   float       *fCells;             // [fNx-1][fNy-1][fNz-1][kCorner][kDimension]
+   float       *fMidplane;          // By at y = 0 [fNx][fNz]
+   EQuantization fQuantization;
+   uint16_t    *fQuant;             // [fNx][fNy][fNz][kDimension]
+   float       *fQuantScale;        // [brick][kDimension] (kInt16)
+   float       *fQuantOffset;       // [brick][kDimension] (kInt16)
+   double       fQuantizationError; // max |B_quantized - B_float| (T)
+   TSamuraiFieldTiles *fTiles;      // tile cache (kTiled)
+   TSamuraiFieldRegistry *fSharedMap;   // shared node-major map (kShared)
+   TSamuraiFieldRegistry *fSharedCells; // shared cell-major copy
+   TSamuraiFieldArena *fArena;      // huge page / NUMA storage
+   std::vector<float*> fReplicas;   // per node copies of the array Eval reads
+   std::string  fFileName;
+   int          fLevel;             // pyramid level evaluated
+   bool         fGeneric;           // never use a fixed-grid kernel
+   typedef bool (*Kernel_t)(const float*,double,double,double,double*);
+   Kernel_t     fKernel;            // fixed-grid Eval for this geometry
+   EVectorISA   fVectorISA;         // kernel used by EvalN
+   TSamuraiFieldCubic *fCubic;      // tricubic coefficients (kTricubic)
+   TSamuraiFieldStats *fStats;      // access statistics (SAMURAI_FIELD_STATS)
+   TSamuraiMagnetField *fPyramid[kMaxLevel]; // levels 1..kMaxLevel
+   int          fNx;                // number of x grid
+   int          fNy;                // number of y grid
+   int          fNz;                // number of z grid
+   double       fDx;                // mesh size x
+   double       fDy;                // mesh size y
+   double       fDz;                // mesh size z
+   double       fX0;                // x of node (0,0,0)
+   double       fY0;                // y of node (0,0,0)
+   double       fZ0;                // z of node (0,0,0)
+   bool         fMirrorX;           // evaluate at |x|
+   bool         fMirrorZ;           // evaluate at |z|
+   size_t       fStrideX;           // = fNy * fNz * kDimension
+   size_t       fStrideY;           // = fNz * kDimension
+   TSamuraiFieldFile::Entry fInfo;
 
    double fScale;
    bool fIsGood;
 
+   // pyramid level holding data (owned) on the grid of info
+   TSamuraiMagnetField(const TSamuraiFieldFile::Entry &info, float *data);
+   void Init(const char* filename, const char* mapName,
+	     const TSamuraiFieldFile::Entry &legacy);
+   void SetGeometry(const TSamuraiFieldFile::Entry &info);
+   void SelectKernel();
+   TSamuraiMagnetField* LoadLevel(int level) const;
+   std::string LevelCacheName(int level, bool tmp) const;
+   bool MapFile(const char* filename, size_t offset, size_t size);
+   bool ReadFile(const char* filename, size_t offset, size_t size,
+		 float *dst);
+   bool AttachShared(const char* filename, size_t size);
+   bool Blend(bool byCurrent, double value);
+   void ReleaseMap();
+   void ReleaseCells();
+   const float* Node(int i, int j, int k) const
+   { return fData + i * fStrideX + j * fStrideY + k * kDimension; }
+   size_t Cell(int i, int j, int k) const
+   { return (((size_t)i * (fNy-1) + j) * (fNz-1) + k) * kCellSize; }
+   void Corners(const float *data, int i, int j, int k,
+		const float *f[kCorner]) const;
+   // corners of cell (i,j,k) in the current storage; decoded is the
+   // buffer for quantized maps. false if a tile cannot be read
+   bool CellCorners(int i, int j, int k, const float *f[kCorner],
+		    float decoded[kCellSize]) const;
+   void PrefetchCell(int i, int j, int k) const;
+   int Replica() const;
+   size_t Brick(int i, int j, int k) const
+   { return (((size_t)(i >> kBrickShift) * ((fNy + kBrick - 1) >> kBrickShift)
+	      + (j >> kBrickShift)) * ((fNz + kBrick - 1) >> kBrickShift)
+	     + (k >> kBrickShift)) * kDimension; }
+   float Decode(size_t node, int i, int j, int k, int axis) const;
+   void DecodeCorners(int i, int j, int k, float *c) const;
+
    bool FindCell(double,double,double,
 		   int*,int*,int*,double*,double*,double*) const;
    void Interpolate(int,int,int,double,double,double,
 		    double*,double*,double*) const;
+   // unscaled b and d[axis][n] = d b[axis] / d (p,q,r)[n]
+   bool InterpolateGradient(int,int,int,double,double,double,
+			    double b[kDimension],
+			    double d[kDimension][kDimension]) const;
+   bool EvalMidplane(double,double,double*) const;
+   // EvalN in the arithmetic of Precision (see TSamuraiPrecision.h)
+   template <class Precision>
+   void EvalBatch(size_t n, const typename Precision::Real_t x[],
+		  const typename Precision::Real_t y[],
+		  const typename Precision::Real_t z[],
+		  typename Precision::Real_t bx[],
+		  typename Precision::Real_t by[],
+		  typename Precision::Real_t bz[]) const;
+   // count a lookup in fStats (SAMURAI_FIELD_STATS)
+   void Record(bool inside, int i, int j, int k) const;
+   void Record(double x, double y, double z) const;
 
    TSamuraiMagnetField(const TSamuraiMagnetField&); // undefined
    TSamuraiMagnetField& operator=(const TSamuraiMagnetField&); // undefined
@@ -0,0 +1,41 @@
+/**
+ * @file   TSamuraiPrecision.h
+ * @brief  precision policies of field lookup and tracing
+ *
+ * @date   Created       : 2026-10-17 21:05:38 JST
+ *         Last Modified : 2026-10-17 21:05:38 JST (kawase)
+ * @author KAWASE Shoichiro <kawase@aees.kyushu-u.ac.jp>
+ *
+ *    (C) 2016 KAWASE Shoichiro
+ */
+
+#ifndef INCLUDE_GUARD_UUID_71C5A9E3_0D4B_4F86_92B7_E3A60F18D5C2
+#define INCLUDE_GUARD_UUID_71C5A9E3_0D4B_4F86_92B7_E3A60F18D5C2
+
+namespace art {
+   struct TDoublePrecision;
+   struct TSinglePrecision;
+}
+
+////////////////////////////////////////////////////////////
+///
+/// Arithmetic type of the batched field lookup
+/// (TSamuraiMagnetField::EvalN) and of the tracing step
+/// (TSamuraiTracer::SetPrecision). The map is stored in float either
+/// way; single precision halves the width of every value, so a vector
+/// register holds twice as many points (8 with AVX2, 16 with AVX-512).
+/// It is meant for display, where the end-plane deviation it causes
+/// (see fieldbench -p) is far below a pixel.
+///
+
+struct art::TDoublePrecision {
+   typedef double Real_t;
+   static const char* Name() {return "double";}
+};
+
+struct art::TSinglePrecision {
+   typedef float Real_t;
+   static const char* Name() {return "float";}
+};
+
+#endif // INCLUDE_GUARD_UUID_71C5A9E3_0D4B_4F86_92B7_E3A60F18D5C2
@@ -16,21 +16,59 @@
 #include <algorithm>
 #include <cmath>
 #include <cstdio>
+#include <string>
+
+#include <pthread.h>
+#include <sys/time.h>
 
 using art::TSamuraiTracer;
+using art::TDoublePrecision;
+using art::TSinglePrecision;
+
+const double TSamuraiTracer::kDefaultPositionTolerance = 1e-2;
+const double TSamuraiTracer::kDefaultAngleTolerance = 1e-5;
+const double TSamuraiTracer::kDefaultMaxStep = 1000.;
+const double TSamuraiTracer::kDefaultDriftMargin = 0.;
+
+struct TSamuraiTracer::AsyncLoad {
+   std::string fFileName;
+   std::string fMapName;
+   double      fScale;
+   TSamuraiMagnetField::EStorage fStorage;
+   FieldSetup_t fSetup;
+   void       *fArg;
+   TSamuraiMagnetField *fField;
+   pthread_t   fThread;
+};
+
+namespace {
+   double Now()
+   {
+      struct timeval tv;
+      gettimeofday(&tv,NULL);
+      return tv.tv_sec + 1e-6 * tv.tv_usec;
+   }
+}
 
 TSamuraiTracer::TSamuraiTracer()
-   : fNMaxPoint(0), fStep(0.), fRotationAngle(0.),
-     fEndPlaneAngle(0.), fEndPlaneDistance(0.), fField(NULL),
-     fFlightLength(0.),
-     fPosition(3,0.), fMomentum(3,0.), fB(3,0.),
-     fRNew(3,0.), fDX(3,0.), fP1(3,0.), fP2(3,0.), fPNew(3,0.),
-     fStatus(-1)
+   : fNMaxPoint(0), fStep(0.), fPreviewLevel(0), fPrecision(kDouble),
+     fIntegrator(kFixedStep), fPositionTolerance(kDefaultPositionTolerance),
+     fAngleTolerance(kDefaultAngleTolerance), fMaxStep(kDefaultMaxStep),
+     fDriftMargin(kDefaultDriftMargin),
+     fRotationAngle(0.),
+     fEndPlaneAngle(0.), fEndPlaneDistance(0.), fField(NULL), fMap(NULL),
+     fCursor(),
+     fFlightLength(0.), fStatistics(),
+     fConditions(), fEndPlane(), fCrossings(), fStopCondition(kNoCondition),
+     fPosition(3,0.), fMomentum(3,0.), fFrameCos(1.), fFrameSin(0.),
+     fPath(0.), fHasBounds(false),
+     fStatus(-1), fPending(NULL)
 {
 }
 
 TSamuraiTracer::~TSamuraiTracer()
 {
+   WaitField();
    delete fField;
 }
 
@@ -38,21 +76,126 @@ bool TSamuraiTracer::LoadField(const char* filename, double scale,
 			       int nx, int ny, int nz,
 			       double dx, double dy, double dz)
 {
-   fField = new TSamuraiMagnetField(filename,scale,
-				    nx,ny,nz,dx,dy,dz);
-   if(!fField->IsGood()) {
+   WaitField();
+   return AcceptField(new TSamuraiMagnetField(filename,scale,
+					      nx,ny,nz,dx,dy,dz),
+		      filename);
+}
+
+bool TSamuraiTracer::LoadField(const char* filename, const char* mapName,
+			       double scale,
+			       TSamuraiMagnetField::EStorage storage)
+{
+   WaitField();
+   return AcceptField(new TSamuraiMagnetField(filename,mapName,scale,storage),
+		      filename);
+}
+
+void* TSamuraiTracer::LoadThread(void *arg)
+{
+   AsyncLoad *const load = static_cast<AsyncLoad*>(arg);
+   load->fField = new TSamuraiMagnetField(load->fFileName.c_str(),
+					  load->fMapName.c_str(),
+					  load->fScale,load->fStorage);
+   if (load->fField->IsGood()) {
+      load->fField->Prefetch();
+      if (load->fSetup) load->fSetup(load->fField,load->fArg);
+   }
+   return NULL;
+}
+
+bool TSamuraiTracer::LoadFieldAsync(const char* filename, const char* mapName,
+				    double scale,
+				    TSamuraiMagnetField::EStorage storage,
+				    FieldSetup_t setup, void *arg)
+{
+   WaitField();
+   AsyncLoad *const load = new AsyncLoad;
+   load->fFileName = filename;
+   load->fMapName  = mapName ? mapName : "";
+   load->fScale    = scale;
+   load->fStorage  = storage;
+   load->fSetup    = setup;
+   load->fArg      = arg;
+   load->fField    = NULL;
+   if (pthread_create(&load->fThread,NULL,LoadThread,load)) {
+      /* no thread: load in place */
+      LoadThread(load);
+      const bool good = AcceptField(load->fField,filename);
+      delete load;
+      return good;
+   }
+   fPending = load;
+   return true;
+}
+
+void TSamuraiTracer::WaitField() const
+{
+   if (!fPending) return;
+   const double start = Now();
+   pthread_join(fPending->fThread,NULL);
+   printf("TSamuraiTracer::LoadField() : waited %.0f ms for the field\n",
+	  1e3 * (Now() - start));
+
+   AsyncLoad *const load = fPending;
+   fPending = NULL;
+   const_cast<TSamuraiTracer*>(this)->AcceptField(load->fField,
+						   load->fFileName.c_str());
+   delete load;
+}
+
+bool TSamuraiTracer::AcceptField(TSamuraiMagnetField *field,
+				 const char* filename)
+{
+   delete fField;
+   fField = fMap = field;
+   fPreviewLevel = 0;
+   if(!fMap->IsGood()) {
       printf("TSamuraiTracer::LoadField() : Failed to load magnet field.\n");
       delete fField;
-      fField = NULL;
+      fField = fMap = NULL;
       fStatus = -2;
       return false;
    }
 
    printf("TSamuraiTracer::LoadField() : filename = %s\n", filename);
+   if (*fMap->GetInfo().fName) {
+      printf("TSamuraiTracer::LoadField() : map = %s (%.1f A)\n",
+	     fMap->GetInfo().fName, fMap->GetInfo().fCurrent);
+   }
    fStatus = 0;
    return true;
 }
 
+bool TSamuraiTracer::SetField(TMagneticField *field)
+{
+   WaitField();
+   delete fField;
+   fField = field;
+   fMap = dynamic_cast<TSamuraiMagnetField*>(field);
+   fPreviewLevel = 0;
+   if (!fField || !fField->IsGood()) {
+      printf("TSamuraiTracer::SetField() : field is not usable.\n");
+      delete fField;
+      fField = fMap = NULL;
+      fStatus = -2;
+      return false;
+   }
+   fStatus = 0;
+   return true;
+}
+
+bool TSamuraiTracer::SetPreviewLevel(int level)
+{
+   WaitField();
+   if (!fMap || !fMap->SetLevel(level)) {
+      printf("TSamuraiTracer::SetPreviewLevel() : level %d not available.\n",level);
+      return false;
+   }
+   fPreviewLevel = level;
+   return true;
+}
+
 void TSamuraiTracer::SetMaxPoint(int nMaxPoint)
 {
    fNMaxPoint = nMaxPoint;
@@ -65,177 +208,698 @@ void TSamuraiTracer::SetMaxPoint(int nMaxPoint)
 }
 
 namespace {
-   inline double xyMag2(const std::vector<double>& vec)
-   {
-      return vec[0] * vec[0] + vec[1] * vec[1];
-   }
-
-   inline double xyMag(const std::vector<double>& vec)
-   {
-      return sqrt(xyMag2(vec));
-   }
-
-   inline double mag2(const std::vector<double>& vec)
+   /* the overloads of std:: pick the float functions for float */
+   template <typename Real>
+   inline Real mag2(const Real vec[])
    {
       return vec[0] * vec[0] + vec[1] * vec[1] + vec[2] * vec[2];
    }
 
-   inline double mag(const std::vector<double>& vec)
+   template <typename Real>
+   inline Real mag(const Real vec[])
    {
-      return sqrt(mag2(vec));
+      return std::sqrt(mag2(vec));
    }
 
-   inline double phi(const std::vector<double>& vec)
+   void Normalize(double u[3])
    {
-      return mag2(vec) == 0. ? 0. : atan2(vec[1],vec[0]);
+      const double norm = mag(u);
+      u[0] /= norm;
+      u[1] /= norm;
+      u[2] /= norm;
    }
 
-   inline double theta(const std::vector<double>& vec)
+   template <typename Real>
+   inline void cross(const Real a[], const Real b[], Real *axb)
    {
-      const double xymag = xyMag(vec);
-      return xymag == 0. ? 0. : atan2(xymag,vec[2]);
+      axb[0] = a[1] * b[2] - a[2] * b[1];
+      axb[1] = a[2] * b[0] - a[0] * b[2];
+      axb[2] = a[0] * b[1] - a[1] * b[0];
    }
 
-
-   inline void deflect(const std::vector<double>& pi,
-		       const std::vector<double>& pb,
-		       const std::vector<double>& b,
-		       double pxy, double step, double charge,
-		       double *pf)
+   /* p rotated about b as by one step in a uniform field, in Cartesian
+      form (Boris): t = tan(angle/2) b/|b|, p' = p + p x t,
+      pf = p + 2/(1+t^2) p' x t. The rotation is exact, so |pf| = |p|
+      up to rounding, for any direction of p. tan(x) ~ x (1 + x^2/3)
+      makes the angle exact to 5th order in the angle, without libm.
+      The sense follows dp = q p x B in all three components; the polar
+      angle update of the former deflect() had it reversed, bending
+      tracks off the midplane the wrong way vertically. */
+   template <typename Real>
+   inline void rotate(const Real p[], const Real b[],
+		      Real step, Real charge, Real *pf)
    {
-      const double c = 2.99792458e+8;
-      const double pi_mag = mag(pi);
-      const double factor = step * c * charge / pi_mag * 1e-9;
-
-      const double dPhi =
-	 factor * (pb[2] * (pb[0]*b[0]+pb[1]*b[1]) /pxy/pxy - b[2]);
-      const double dTheta =
-	 factor * (pb[0]*b[1]-pb[1]*b[0]) / pxy;
-
-      const double pf_theta = theta(pi) + dTheta;
-      const double pf_phi   = phi(pi) + dPhi;
-
-      pf[0] = pi_mag * sin(pf_theta) * cos(pf_phi);
-      pf[1] = pi_mag * sin(pf_theta) * sin(pf_phi);
-      pf[2] = pi_mag * cos(pf_theta);
+      const Real c = 2.99792458e+8;
+      const Real half = step * c * charge / mag(p) * (Real)5e-10;
+      const Real half2 = half * half * mag2(b);
+      const Real scale = half * (1 + half2 / 3);
+      const Real t[3] = {scale * b[0], scale * b[1], scale * b[2]};
+      const Real s = 2 / (1 + mag2(t));
+
+      Real pt[3], ptt[3];
+      cross(p,t,pt);
+      pt[0] += p[0];
+      pt[1] += p[1];
+      pt[2] += p[2];
+      cross(pt,t,ptt);
+      pf[0] = p[0] + s * ptt[0];
+      pf[1] = p[1] + s * ptt[1];
+      pf[2] = p[2] + s * ptt[2];
    }
 }
 
 bool TSamuraiTracer::Trace(const double xi[], const double pi[], double charge)
 {
+   WaitField();
+   SetFrame();
    {  /* initialize temporary variables */
-      std::copy(xi,xi+3,fPosition.begin());
-      std::copy(pi,pi+3,fMomentum.begin());
+      ToMagnetFrame(xi,&fPosition[0]);
+      ToMagnetFrame(pi,&fMomentum[0]);
       fX.clear();
       fY.clear();
       fZ.clear();
-      fB.assign(3,0.);
-      fRNew.assign(3,0.);
-      fDX.assign(3,0.);
-      fP1.assign(3,0.);
-      fP2.assign(3,0.);
-      fPNew.assign(3,0.);
       fCharge = charge;
       fFlightLength = 0./0.;
+      fCursor.Reset(fMap);
+      fStatistics = Statistics();
+      fCrossings.clear();
+      fStopCondition = kNoCondition;
+      fPath = 0.;
+      const double p = mag(&fMomentum[0]);
+      for (int i = 0; i != 3; ++i) fStartDirection[i] = fMomentum[i] / p;
    }
 
-   for (int i = 0; i != fNMaxPoint; ++i)
-   {
-      TraceOneStep();
-      const double d = DistanceToEndPlane();
-      if (d < 0.) {
-	 const double pi = 3.14159265359;
-	 const double deg2rad = pi / 180.;
-	 const double c = cos(fEndPlaneAngle * deg2rad);
-	 const double s = sin(fEndPlaneAngle * deg2rad);
-	 const double p = mag(fMomentum);
-	 const double pdotn = -fMomentum[0]*s + fMomentum[1]*c;
-	 fFlightLength = (i+1) * fStep + d*p/pdotn;
-	 return true;
+   if (fIntegrator == kDormandPrince) {
+      TraceAdaptive();
+   } else {
+      Span span;
+      span.fCont = NULL;
+      for (int i = 0; i != fNMaxPoint; )
+      {
+	 bool stopped = false;
+	 if (const int n = Drift(Step(),fNMaxPoint - i,&stopped)) {
+	    i += n;
+	    if (stopped) break;
+	    continue;
+	 }
+
+	 std::copy(fPosition.begin(),fPosition.end(),span.fR0);
+	 std::copy(fMomentum.begin(),fMomentum.end(),span.fU0);
+	 if (fPrecision == kSingle) {
+	    TraceOneStep<TSinglePrecision>();
+	 } else {
+	    TraceOneStep<TDoublePrecision>();
+	 }
+	 ++i;
+	 std::copy(fPosition.begin(),fPosition.end(),span.fR1);
+	 std::copy(fMomentum.begin(),fMomentum.end(),span.fU1);
+	 Normalize(span.fU0);
+	 Normalize(span.fU1);
+	 span.fS0 = fPath;
+	 span.fH = Step();
+	 fPath += Step();
+	 if (CheckConditions(span)) break;
       }
    }
 
-   return false;
+   ToLabFrame();
+   return fStopCondition != kNoCondition;
 }
 
 
+template <class Precision>
 void TSamuraiTracer::TraceOneStep()
 {
-   const std::vector<double>& p0 = fMomentum;
-   const std::vector<double>& r0 = fPosition;
-   std::copy(fMomentum.begin(),fMomentum.end(),fPNew.begin());
+   typedef typename Precision::Real_t Real;
+   Real p0[3], r0[3], b0[3], b[3], pNew[3], dx[3], rNew[3];
+   for (int i = 0; i != 3; ++i) {
+      p0[i] = fMomentum[i];
+      r0[i] = fPosition[i];
+   }
+   double field[3], at[3];
 
-   ReadMagneticFieldAt(r0,&fB[0]);
+   ++fStatistics.fAccepted;
+   SetLookAhead(&fMomentum[0],Step());
+   ReadMagneticFieldAt(&fPosition[0],field);
+   std::copy(field,field + 3,b0);
 
-   deflect(p0,p0,fB,xyMag(p0),fStep,fCharge,&fP1[0]);
+   const Real step = Step();
+   const Real charge = fCharge;
 
+   /* predicted with the field at the start, corrected with the mean of
+      the fields at both ends */
    const int N_ITERATION = 2;
    for (int i = 0; i != N_ITERATION; ++i) {
-      if (i) ReadMagneticFieldAt(fRNew,&fB[0]);
+      if (i) {
+	 std::copy(rNew,rNew + 3,at);
+	 ReadMagneticFieldAt(at,field);
+	 for (int j = 0; j != 3; ++j) b[j] = (b0[j] + (Real)field[j]) / 2;
+      } else {
+	 std::copy(b0,b0 + 3,b);
+      }
 
-      deflect(p0,fP1,fB,xyMag(fPNew),fStep,fCharge,&fP2[0]);
+      rotate(p0,b,step,charge,pNew);
 
-      fPNew[0] = (fP1[0] + fP2[0])/2;
-      fPNew[1] = (fP1[1] + fP2[1])/2;
-      fPNew[2] = (fP1[2] + fP2[2])/2;
+      dx[0] = p0[0] + pNew[0];
+      dx[1] = p0[1] + pNew[1];
+      dx[2] = p0[2] + pNew[2];
+      const Real mult = step / mag(dx);
+      rNew[0] = r0[0] + dx[0] * mult;
+      rNew[1] = r0[1] + dx[1] * mult;
+      rNew[2] = r0[2] + dx[2] * mult;
+   }
 
-      fDX[0] = p0[0] + fPNew[0];
-      fDX[1] = p0[1] + fPNew[1];
-      fDX[2] = p0[2] + fPNew[2];
-      const double mult = fStep / mag(fDX);
-      fRNew[0] = r0[0] + fDX[0] * mult;
-      fRNew[1] = r0[1] + fDX[1] * mult;
-      fRNew[2] = r0[2] + fDX[2] * mult;
+   std::copy(rNew,rNew + 3,fPosition.begin());
+   std::copy(pNew,pNew + 3,fMomentum.begin());
+   fX.push_back(rNew[0]);
+   fY.push_back(rNew[1]);
+   fZ.push_back(rNew[2]);
+}
+
+void TSamuraiTracer::SetFrame()
+{
+   const double pi = 3.14159265359;
+   const double deg2rad = pi / 180.;
+   fFrameCos = cos(fRotationAngle * deg2rad);
+   fFrameSin = sin(fRotationAngle * deg2rad);
+
+   fEndPlane.fType = Condition::kPlane;
+   fEndPlane.fAction = kStop;
+   fEndPlane.fLab[0] = fEndPlaneDistance;
+   fEndPlane.fLab[1] = fEndPlaneAngle;
+   Orient(&fEndPlane);
+   for (size_t i = 0; i != fConditions.size(); ++i) {
+      Orient(&fConditions[i]);
+   }
+
+   /* x, y, z of the field are x, z, y of the magnet frame */
+   double min[3], max[3];
+   fHasBounds = fField && fField->GetBounds(min,max);
+   if (fHasBounds) {
+      static const int kAxis[3] = {0,2,1};
+      for (int i = 0; i != 3; ++i) {
+	 fBoundsMin[i] = min[kAxis[i]] - fDriftMargin;
+	 fBoundsMax[i] = max[kAxis[i]] + fDriftMargin;
+      }
+   }
+}
+
+int TSamuraiTracer::Drift(double step, int nMax, bool *stopped)
+{
+   if (!fHasBounds || nMax <= 0) return 0;
+   const double *const x = &fPosition[0];
+   const double p = mag(&fMomentum[0]);
+   const double u[3] = {fMomentum[0] / p,fMomentum[1] / p,fMomentum[2] / p};
+
+   /* path length to the entry into the bounds (slab method) */
+   double enter = 0., leave = HUGE_VAL;
+   for (int i = 0; i != 3; ++i) {
+      if (u[i] == 0.) {
+	 if (x[i] < fBoundsMin[i] || fBoundsMax[i] < x[i]) enter = HUGE_VAL;
+	 continue;
+      }
+      const double t0 = (fBoundsMin[i] - x[i]) / u[i];
+      const double t1 = (fBoundsMax[i] - x[i]) / u[i];
+      enter = std::max(enter,std::min(t0,t1));
+      leave = std::min(leave,std::max(t0,t1));
    }
+   if (enter > leave) enter = HUGE_VAL; // never enters
+   if (enter <= 0.) return 0;           // inside
+
+   /* steps ending short of the entry, and at most one beyond a
+      plane or the flight length limit */
+   double n = enter < HUGE_VAL ? ceil(enter / step) - 1. : nMax;
+   const int nCondition = fConditions.size();
+   for (int i = -1; i != nCondition; ++i) {
+      const Condition &c = i < 0 ? fEndPlane : fConditions[i];
+      const double g = Value(c,x,u,fPath);
+      if (g < 0.) continue;
+      double rate = 0.; // decrease of g per mm
+      if (c.fType == Condition::kPlane || c.fType == Condition::kRectangle) {
+	 rate = u[0]*c.fNormal[0] + u[1]*c.fNormal[1];
+      } else if (c.fType == Condition::kMaxLength) {
+	 rate = 1.;
+      }
+      if (rate > 0.) n = std::min(n,floor(g / (step * rate)) + 1.);
+   }
+   const int nStep = (int)std::min(n,(double)nMax);
+   if (nStep <= 0) return 0;
+
+   const double x0[3] = {x[0],x[1],x[2]};
+   for (int k = 1; k <= nStep; ++k) {
+      const double s = k * step;
+      fX.push_back(x0[0] + s * u[0]);
+      fY.push_back(x0[1] + s * u[1]);
+      fZ.push_back(x0[2] + s * u[2]);
+   }
+   fStatistics.fDrift += nStep;
 
-   std::copy(fRNew.begin(),fRNew.end(),fPosition.begin());
-   std::copy(fPNew.begin(),fPNew.end(),fMomentum.begin());
-   fX.push_back(fRNew[0]);
-   fY.push_back(fRNew[1]);
-   fZ.push_back(fRNew[2]);
+   /* only the last step can meet a condition */
+   Span span;
+   for (int i = 0; i != 3; ++i) {
+      span.fR0[i] = x0[i] + (nStep - 1) * step * u[i];
+      span.fU0[i] = span.fU1[i] = u[i];
+   }
+   span.fR1[0] = fPosition[0] = fX.back();
+   span.fR1[1] = fPosition[1] = fY.back();
+   span.fR1[2] = fPosition[2] = fZ.back();
+   span.fS0 = fPath + (nStep - 1) * step;
+   span.fH = step;
+   span.fCont = NULL;
+   fPath += nStep * step;
+   *stopped = CheckConditions(span);
+   return nStep;
+}
+
+void TSamuraiTracer::ToMagnetFrame(const double v[], double *w) const
+{
+   const double x = v[0];
+   const double y = v[1];
+   w[0] = fFrameCos * x + fFrameSin * y;
+   w[1] = fFrameCos * y - fFrameSin * x;
+   w[2] = v[2];
+}
+
+void TSamuraiTracer::ToLabFrame()
+{
+   /* the recorded points at once, then the last state */
+   const size_t n = fX.size();
+   double *const x = n ? &fX[0] : NULL;
+   double *const y = n ? &fY[0] : NULL;
+   for (size_t i = 0; i != n; ++i) {
+      const double xm = x[i];
+      const double ym = y[i];
+      x[i] = fFrameCos * xm - fFrameSin * ym;
+      y[i] = fFrameSin * xm + fFrameCos * ym;
+   }
+
+   double *const vectors[] = {&fPosition[0],&fMomentum[0]};
+   for (int i = 0; i != 2; ++i) {
+      double *const v = vectors[i];
+      const double xm = v[0];
+      const double ym = v[1];
+      v[0] = fFrameCos * xm - fFrameSin * ym;
+      v[1] = fFrameSin * xm + fFrameCos * ym;
+   }
+   for (size_t i = 0; i != fCrossings.size(); ++i) {
+      double *const v[2] = {fCrossings[i].fPosition,fCrossings[i].fMomentum};
+      for (int j = 0; j != 2; ++j) {
+	 const double xm = v[j][0];
+	 const double ym = v[j][1];
+	 v[j][0] = fFrameCos * xm - fFrameSin * ym;
+	 v[j][1] = fFrameSin * xm + fFrameCos * ym;
+      }
+   }
+}
+
+void TSamuraiTracer::ReadMagneticFieldAt(const double x[], double *b)
+{
+   ++fStatistics.fEvals;
+   if (fMap) {
+      fCursor.Eval(x[0],x[2],x[1],b,b+2,b+1);
+   } else {
+      fField->Eval(x[0],x[2],x[1],b,b+2,b+1);
+   }
+   b[0] = -b[0];
+}
+
+void TSamuraiTracer::SetLookAhead(const double p[], double length)
+{
+   /* length along p, in the frame of the map */
+   const double mult = length / mag(p);
+   fCursor.SetLookAhead(p[0] * mult,p[2] * mult,p[1] * mult);
 }
 
 namespace {
-   void Rotate2D(double x, double y, double angle,
-		double *xrot, double *yrot)
+   /* Dormand-Prince 5(4) with its continuous extension of order 4
+      (E. Hairer, S.P. Norsett, G. Wanner, Solving Ordinary Differential
+      Equations I, 2nd ed., II.5 and II.6) */
+   const int kStage = 7;
+   const int kState = 6; // position (mm), unit momentum
+   const double kA[kStage][kStage-1] = {
+      { 0. },
+      { 1./5. },
+      { 3./40., 9./40. },
+      { 44./45., -56./15., 32./9. },
+      { 19372./6561., -25360./2187., 64448./6561., -212./729. },
+      { 9017./3168., -355./33., 46732./5247., 49./176., -5103./18656. },
+      { 35./384., 0., 500./1113., 125./192., -2187./6784., 11./84. },
+   };
+   // 5th order weights minus 4th order ones
+   const double kE[kStage] = {
+      71./57600., 0., -71./16695., 71./1920., -17253./339200., 22./525., -1./40.
+   };
+   const double kD[kStage] = {
+      -12715105075./11282082432., 0., 87487479700./32700410799.,
+      -10690763975./1880347072., 701980252875./199316789632.,
+      -1453857185./822651844., 69997945./29380423.
+   };
+   const double kMinStep = 1e-3; // mm, taken whatever its error
+   const int kMaxLocate = 50;    // iterations to locate a condition
+   const double kLocateTolerance = 1e-10; // |value| at the located point
+
+   // state at theta (0..1) of the step from the continuous extension
+   void DenseOutput(const double cont[5 * kState], double theta,
+		    double y[kState])
    {
-      const double s = sin(angle);
-      const double c = cos(angle);
-      const double xold = x;
-      const double yold = y;
-      *xrot = c*xold - s*yold;
-      *yrot = s*xold + c*yold;
+      const double theta1 = 1. - theta;
+      for (int i = 0; i != kState; ++i) {
+	 y[i] = cont[i] + theta * (cont[kState + i]
+	    + theta1 * (cont[2 * kState + i] + theta * (cont[3 * kState + i]
+	    + theta1 * cont[4 * kState + i])));
+      }
    }
 }
 
-void TSamuraiTracer::ReadMagneticFieldAt(const std::vector<double> &x,
-					 double *b) const
+void TSamuraiTracer::Derivative(const double y[], double kappa, double dy[])
 {
-   const double pi = 3.14159265359;
-   const double deg2rad = pi / 180.;
-   double xrot, yrot;
-   Rotate2D(x[0],x[1],-fRotationAngle * deg2rad,&xrot,&yrot);
-   fField->Eval(xrot,x[2],yrot,b,b+2,b+1);
-   b[0] = -b[0];
-   Rotate2D(b[0],b[1], fRotationAngle * deg2rad,&b[0],&b[1]);
+   double b[3];
+   ReadMagneticFieldAt(y,b);
+   const double *const u = y + 3;
+   dy[0] = u[0];
+   dy[1] = u[1];
+   dy[2] = u[2];
+   /* du/ds = q/p u x B */
+   dy[3] = kappa * (u[1]*b[2] - u[2]*b[1]);
+   dy[4] = kappa * (u[2]*b[0] - u[0]*b[2]);
+   dy[5] = kappa * (u[0]*b[1] - u[1]*b[0]);
+}
+
+bool TSamuraiTracer::TraceAdaptive()
+{
+   const double c = 2.99792458e+8;
+   const double p = mag(&fMomentum[0]);
+   if (p == 0.) return false;
+   const double kappa = c * fCharge / p * 1e-9; // 1/(T mm)
+
+   double y[kState], yStage[kState], yNew[kState], k[kStage][kState];
+   std::copy(fPosition.begin(),fPosition.end(),y);
+   for (int i = 0; i != 3; ++i) y[3+i] = fMomentum[i] / p;
+   Derivative(y,kappa,k[0]);
+
+   double h = std::min(Step(),fMaxStep);
+   while ((int)fX.size() < fNMaxPoint) {
+      /* out of the field: straight to its bounds or a condition */
+      bool stopped = false;
+      if (Drift(fMaxStep,fNMaxPoint - (int)fX.size(),&stopped)) {
+	 if (stopped) return true;
+	 /* no field at the end of the drift */
+	 std::copy(fPosition.begin(),fPosition.end(),y);
+	 std::copy(y + 3,y + 6,k[0]);
+	 std::fill(k[0] + 3,k[0] + 6,0.);
+	 continue;
+      }
+
+      SetLookAhead(y + 3,h);
+      for (int stage = 1; stage != kStage; ++stage) {
+	 double *const dst = stage == kStage - 1 ? yNew : yStage;
+	 for (int i = 0; i != kState; ++i) {
+	    double sum = 0.;
+	    for (int j = 0; j != stage; ++j) sum += kA[stage][j] * k[j][i];
+	    dst[i] = y[i] + h * sum;
+	 }
+	 Derivative(dst,kappa,k[stage]);
+      }
+
+      /* length of the error estimates of position and direction in
+	 units of their tolerances (independent of the frame) */
+      double err[kState];
+      for (int i = 0; i != kState; ++i) {
+	 err[i] = 0.;
+	 for (int j = 0; j != kStage; ++j) err[i] += kE[j] * k[j][i];
+	 err[i] *= h;
+      }
+      const double norm = std::max(mag(err) / fPositionTolerance,
+				   mag(err + 3) / fAngleTolerance);
+      const double grow = norm > 0. ? 0.9 * pow(norm,-0.2) : 5.;
+      if (norm > 1. && h > kMinStep) {
+	 ++fStatistics.fRejected;
+	 h = std::max(kMinStep,h * std::max(0.2,grow));
+	 continue;
+      }
+      ++fStatistics.fAccepted;
+
+      /* continuous extension of the step */
+      double cont[5 * kState];
+      for (int i = 0; i != kState; ++i) {
+	 const double diff = yNew[i] - y[i];
+	 const double bspl = h * k[0][i] - diff;
+	 double dense = 0.;
+	 for (int j = 0; j != kStage; ++j) dense += kD[j] * k[j][i];
+	 cont[i] = y[i];
+	 cont[kState + i] = diff;
+	 cont[2 * kState + i] = bspl;
+	 cont[3 * kState + i] = diff - h * k[kStage-1][i] - bspl;
+	 cont[4 * kState + i] = h * dense;
+      }
+
+      Normalize(yNew + 3);
+      for (int i = 0; i != 3; ++i) {
+	 fPosition[i] = yNew[i];
+	 fMomentum[i] = p * yNew[3+i];
+      }
+      fX.push_back(yNew[0]);
+      fY.push_back(yNew[1]);
+      fZ.push_back(yNew[2]);
+
+      Span span;
+      std::copy(y,y + 3,span.fR0);
+      std::copy(y + 3,y + 6,span.fU0);
+      std::copy(yNew,yNew + 3,span.fR1);
+      std::copy(yNew + 3,yNew + 6,span.fU1);
+      span.fS0 = fPath;
+      span.fH = h;
+      span.fCont = cont;
+      fPath += h;
+      if (CheckConditions(span)) return true;
+
+      /* the last stage is evaluated at yNew: first stage of the next step */
+      std::copy(yNew,yNew + kState,y);
+      std::copy(k[kStage-1],k[kStage-1] + kState,k[0]);
+      h = std::min(fMaxStep,h * std::min(5.,grow));
+   }
+
+   return false;
 }
 
-double TSamuraiTracer::DistanceToEndPlane() const
+int TSamuraiTracer::AddCondition(Condition::EType type, EAction action,
+				 const char *name, const double lab[], int nLab)
+{
+   Condition condition = Condition();
+   condition.fType = type;
+   condition.fAction = action;
+   condition.fName = name ? name : "";
+   std::copy(lab,lab + nLab,condition.fLab);
+   fConditions.push_back(condition);
+   return fConditions.size() - 1;
+}
+
+int TSamuraiTracer::AddPlane(double distance, double angle, EAction action,
+			     const char *name)
+{
+   const double lab[] = {distance,angle};
+   return AddCondition(Condition::kPlane,action,name,lab,2);
+}
+
+int TSamuraiTracer::AddRectangle(double x, double y, double angle,
+				 double width, double height, EAction action,
+				 const char *name)
+{
+   const double lab[] = {x,y,angle,width,height};
+   return AddCondition(Condition::kRectangle,action,name,lab,5);
+}
+
+int TSamuraiTracer::AddMaxLength(double length, const char *name)
+{
+   return AddCondition(Condition::kMaxLength,kStop,name,&length,1);
+}
+
+int TSamuraiTracer::AddMaxBend(double angle, const char *name)
+{
+   return AddCondition(Condition::kMaxBend,kStop,name,&angle,1);
+}
+
+void TSamuraiTracer::Orient(Condition *c) const
 {
    const double pi = 3.14159265359;
    const double deg2rad = pi / 180.;
-   const double c = cos(fEndPlaneAngle * deg2rad);
-   const double s = sin(fEndPlaneAngle * deg2rad);
-   return fEndPlaneDistance - (-fPosition[0]*s + fPosition[1]*c);
+   switch (c->fType) {
+      case Condition::kPlane:
+      case Condition::kRectangle: {
+	 const bool rectangle = c->fType == Condition::kRectangle;
+	 const double angle = (rectangle ? c->fLab[2] : c->fLab[1]) * deg2rad;
+	 /* normal (-sin, cos) and tangent (cos, sin) in the lab frame */
+	 const double normal[3] = {-sin(angle),cos(angle),0.};
+	 const double tangent[3] = {cos(angle),sin(angle),0.};
+	 double v[3];
+	 ToMagnetFrame(normal,v);
+	 c->fNormal[0] = v[0];
+	 c->fNormal[1] = v[1];
+	 ToMagnetFrame(tangent,v);
+	 c->fTangent[0] = v[0];
+	 c->fTangent[1] = v[1];
+	 if (rectangle) {
+	    const double center[3] = {c->fLab[0],c->fLab[1],0.};
+	    ToMagnetFrame(center,v);
+	    c->fCenter[0] = v[0];
+	    c->fCenter[1] = v[1];
+	    c->fDistance = v[0]*c->fNormal[0] + v[1]*c->fNormal[1];
+	    c->fHalfWidth = c->fLab[3] / 2;
+	    c->fHalfHeight = c->fLab[4] / 2;
+	 } else {
+	    c->fDistance = c->fLab[0];
+	 }
+	 break;
+      }
+      case Condition::kMaxLength:
+	 c->fLimit = c->fLab[0];
+	 break;
+      case Condition::kMaxBend:
+	 c->fLimit = cos(c->fLab[0] * deg2rad);
+	 break;
+   }
+}
+
+double TSamuraiTracer::Value(const Condition &c, const double r[],
+			     const double u[], double s) const
+{
+   switch (c.fType) {
+      case Condition::kMaxLength:
+	 return c.fLimit - s;
+      case Condition::kMaxBend:
+	 return u[0]*fStartDirection[0] + u[1]*fStartDirection[1]
+	    + u[2]*fStartDirection[2] - c.fLimit;
+      default:
+	 return c.fDistance - (r[0]*c.fNormal[0] + r[1]*c.fNormal[1]);
+   }
+}
+
+void TSamuraiTracer::Interpolate(const Span &span, double theta,
+				 double r[], double u[])
+{
+   if (span.fCont) {
+      double y[kState];
+      DenseOutput(span.fCont,theta,y);
+      std::copy(y,y + 3,r);
+      std::copy(y + 3,y + 6,u);
+   } else {
+      /* cubic Hermite of the positions and directions at both ends */
+      const double t2 = theta * theta;
+      const double t3 = t2 * theta;
+      const double h00 = 2*t3 - 3*t2 + 1;
+      const double h10 = t3 - 2*t2 + theta;
+      const double h01 = 3*t2 - 2*t3;
+      const double h11 = t3 - t2;
+      const double d00 = 6*t2 - 6*theta; // derivatives, d01 = -d00
+      const double d10 = 3*t2 - 4*theta + 1;
+      const double d11 = 3*t2 - 2*theta;
+      const double h = span.fH;
+      for (int i = 0; i != 3; ++i) {
+	 r[i] = h00 * span.fR0[i] + h10 * h * span.fU0[i]
+	    + h01 * span.fR1[i] + h11 * h * span.fU1[i];
+	 u[i] = d00 * (span.fR0[i] - span.fR1[i]) / h
+	    + d10 * span.fU0[i] + d11 * span.fU1[i];
+      }
+   }
+   Normalize(u);
+}
+
+bool TSamuraiTracer::CheckConditions(const Span &span)
+{
+   /* the first kStop condition met in the step ends the trace; the
+      kRecord ones met before it are recorded in order */
+   int stop = kNoCondition;
+   double stopTheta = 2.;
+   std::vector<std::pair<double,int> > records;
+
+   const int nCondition = fConditions.size();
+   for (int i = -1; i != nCondition; ++i) {
+      const Condition &c = i < 0 ? fEndPlane : fConditions[i];
+      const double g0 = Value(c,span.fR0,span.fU0,span.fS0);
+      const double g1 = Value(c,span.fR1,span.fU1,span.fS0 + span.fH);
+      if (!(g0 >= 0. && g1 < 0.)) continue;
+
+      /* the flight length is linear in theta; others are located on the
+	 interpolant (Illinois) */
+      double theta = g0 / (g0 - g1);
+      double r[3], u[3];
+      if (c.fType != Condition::kMaxLength) {
+	 double lo = 0., hi = 1., glo = g0, ghi = g1;
+	 int side = 0;
+	 for (int n = 0; n != kMaxLocate; ++n) {
+	    theta = (lo * ghi - hi * glo) / (ghi - glo);
+	    Interpolate(span,theta,r,u);
+	    const double g = Value(c,r,u,span.fS0 + theta * span.fH);
+	    if (fabs(g) < kLocateTolerance) break;
+	    if (g > 0.) {
+	       lo = theta;
+	       glo = g;
+	       if (side == 1) ghi /= 2;
+	       side = 1;
+	    } else {
+	       hi = theta;
+	       ghi = g;
+	       if (side == -1) glo /= 2;
+	       side = -1;
+	    }
+	 }
+      }
+      if (c.fType == Condition::kRectangle) {
+	 Interpolate(span,theta,r,u);
+	 const double along = (r[0] - c.fCenter[0]) * c.fTangent[0]
+	    + (r[1] - c.fCenter[1]) * c.fTangent[1];
+	 if (fabs(along) > c.fHalfWidth) continue;
+	 if (c.fHalfHeight > 0. && fabs(r[2]) > c.fHalfHeight) continue;
+      }
+
+      if (c.fAction == kRecord) {
+	 records.push_back(std::make_pair(theta,i));
+      } else if (theta < stopTheta) {
+	 stop = i;
+	 stopTheta = theta;
+      }
+   }
+   if (records.empty() && stop == kNoCondition) return false;
+
+   const double p = mag(&fMomentum[0]);
+   std::sort(records.begin(),records.end());
+   for (size_t i = 0; i != records.size(); ++i) {
+      const double theta = records[i].first;
+      if (theta > stopTheta) break;
+      Crossing crossing;
+      crossing.fCondition = records[i].second;
+      crossing.fLength = span.fS0 + theta * span.fH;
+      double u[3];
+      Interpolate(span,theta,crossing.fPosition,u);
+      for (int j = 0; j != 3; ++j) crossing.fMomentum[j] = p * u[j];
+      fCrossings.push_back(crossing);
+   }
+   if (stop == kNoCondition) return false;
+
+   /* the last point is moved back onto the condition */
+   double r[3], u[3];
+   Interpolate(span,stopTheta,r,u);
+   for (int i = 0; i != 3; ++i) {
+      fPosition[i] = r[i];
+      fMomentum[i] = p * u[i];
+   }
+   fX.back() = r[0];
+   fY.back() = r[1];
+   fZ.back() = r[2];
+   fFlightLength = span.fS0 + stopTheta * span.fH;
+   fStopCondition = stop;
+   return true;
 }
 
 double TSamuraiTracer::GetCentralField() const
 {
+   WaitField();
    return fField->GetCentralField();
 }
 
 void TSamuraiTracer::ScaleCentralFieldTo(double field)
 {
+   WaitField();
    fField->ResetScale();
    const double newScale = field / fField->GetCentralField();
    fField->SetScale(newScale);
@@ -12,15 +12,37 @@
 #ifndef INCLUDE_GUARD_UUID_17117C21_DF6C_4A68_8A3F_21591906DCCE
 #define INCLUDE_GUARD_UUID_17117C21_DF6C_4A68_8A3F_21591906DCCE
 
+#include "TMagneticField.h"
+#include "TSamuraiMagnetField.h"
+#include "TSamuraiFieldCursor.h"
+#include "TSamuraiPrecision.h"
+
+#include <string>
 #include <vector>
 
 namespace art {
    class TSamuraiTracer;
-   class TSamuraiMagnetField;
 }
 
 class art::TSamuraiTracer {
 public:
+   // arithmetic of the step (TDoublePrecision / TSinglePrecision)
+   enum EPrecision { kDouble, kSingle };
+   // kFixedStep: predictor-corrector of fixed step length
+   // kDormandPrince: embedded Runge-Kutta 5(4) with step size control
+   enum EIntegrator { kFixedStep, kDormandPrince };
+   static const double kDefaultPositionTolerance; // mm
+   static const double kDefaultAngleTolerance;    // rad
+   static const double kDefaultMaxStep;           // mm
+   static const double kDefaultDriftMargin;       // mm
+   // of the last trajectory
+   struct Statistics {
+      unsigned long fAccepted; // steps taken
+      unsigned long fRejected; // steps retried shorter (kDormandPrince)
+      unsigned long fEvals;    // field lookups
+      unsigned long fDrift;    // straight steps out of the field bounds
+   };
+
    TSamuraiTracer();
    ~TSamuraiTracer();
 
@@ -30,56 +52,210 @@ public:
    };
    void SetEndPlaneDistance(double dist) { fEndPlaneDistance = dist;}
    void SetEndPlaneAngle(double angle) { fEndPlaneAngle = angle;}
+
+   // conditions checked along the trace besides the end plane. A plane
+   // is given like the end plane (lab frame): the points at distance
+   // (mm) along the direction at angle (deg) from +y towards -x, crossed
+   // along that direction. A rectangle is the part of the plane at angle
+   // through (x,y) within width/2 of (x,y) horizontally and height/2 of
+   // the midplane (height <= 0: unbounded). The trace stops at kStop
+   // conditions; kRecord ones are listed in GetCrossings(). Crossings
+   // are located within the step on its interpolant, without field
+   // lookups. Each returns the index of the condition.
+   enum EAction { kStop, kRecord };
+   int AddPlane(double distance, double angle, EAction action = kStop,
+		const char *name = "");
+   int AddRectangle(double x, double y, double angle,
+		    double width, double height, EAction action = kRecord,
+		    const char *name = "");
+   // stop at the flight length (mm)
+   int AddMaxLength(double length, const char *name = "");
+   // stop when the momentum has turned by angle (deg, < 180) from its
+   // initial direction
+   int AddMaxBend(double angle, const char *name = "");
+   void ClearConditions() {fConditions.clear();}
+   int GetNConditions() const {return fConditions.size();}
+   const char* GetConditionName(int i) const
+   {return i == kEndPlane ? "end plane" : fConditions[i].fName.c_str();}
+   // a condition met during the last trace (lab frame)
+   struct Crossing {
+      int    fCondition;   // index, or kEndPlane
+      double fLength;      // flight length (mm)
+      double fPosition[3]; // mm
+      double fMomentum[3]; // MeV/c
+   };
+   static const int kEndPlane = -1;
+   static const int kNoCondition = -2;
+   // kRecord crossings of the last trace in the order met
+   const std::vector<Crossing>& GetCrossings() const {return fCrossings;}
+   // condition which ended the last trace, kNoCondition if it ran out
+   // of points
+   int GetStopCondition() const {return fStopCondition;}
    void SetMaxPoint(int nMaxPoint);
    void SetStepLength(double step) {fStep = step;};
    void SetRotationAngle(double angle) {fRotationAngle = angle;}
+   // trace on field pyramid level (0: full map) with the step length
+   // scaled by the same 2^level
+   bool SetPreviewLevel(int level);
+   int GetPreviewLevel() const {return fPreviewLevel;}
+   // kSingle steps in float, for display; positions and momenta are
+   // kept in double between steps
+   void SetPrecision(EPrecision precision) {fPrecision = precision;}
+   EPrecision GetPrecision() const {return fPrecision;}
+   void SetIntegrator(EIntegrator integrator) {fIntegrator = integrator;}
+   EIntegrator GetIntegrator() const {return fIntegrator;}
+   // kDormandPrince: allowed local error per step in position (mm) and
+   // direction (rad), and the longest step (mm). The step length set by
+   // SetStepLength() is the first trial step.
+   void SetTolerance(double position, double angle)
+   {fPositionTolerance = position; fAngleTolerance = angle;}
+   void SetMaxStepLength(double step) {fMaxStep = step;}
+   // outside the bounds of the field (TMagneticField::GetBounds) widened
+   // by margin (mm), steps are straight lines without field lookups
+   void SetDriftMargin(double margin) {fDriftMargin = margin;}
+   double GetDriftMargin() const {return fDriftMargin;}
 
    bool LoadField(const char* filename, double scale = 1.,
 		  int nx = 301, int ny = 81, int nz = 301,
 		  double dx = 10, double dy = 10, double dz = 10);
+   // load map named mapName from a field container (see TSamuraiFieldFile)
+   bool LoadField(const char* filename, const char* mapName,
+		  double scale = 1.,
+		  TSamuraiMagnetField::EStorage storage = TSamuraiMagnetField::kMmap);
+   // load in a background thread and return at once; setup(field,arg)
+   // runs in that thread after the load. Calls needing the field wait
+   // for the load to finish.
+   typedef void (*FieldSetup_t)(TSamuraiMagnetField *field, void *arg);
+   bool LoadFieldAsync(const char* filename, const char* mapName,
+		       double scale = 1.,
+		       TSamuraiMagnetField::EStorage storage = TSamuraiMagnetField::kMmap,
+		       FieldSetup_t setup = NULL, void *arg = NULL);
+
+   // trace in any field (analytic, composite, ...); the tracer takes
+   // ownership. Field map specific features (preview levels, the
+   // evaluation cursor) apply when field is a TSamuraiMagnetField.
+   bool SetField(TMagneticField *field);
 
-   // trace trajectory. returns true if the trajectory reached the end plane.
+   // trace trajectory. returns true if the trajectory reached the end
+   // plane or another kStop condition; the last point is then on it.
    bool Trace(const double xi[], const double pi[], double charge = 1);
    double GetFlightLength() const {return fFlightLength;};
    const std::vector<double>& GetXArray() const {return fX;};
    const std::vector<double>& GetYArray() const {return fY;};
    const std::vector<double>& GetZArray() const {return fZ;};
 
+   // the field map traced, NULL if the field is not a map
+   TSamuraiMagnetField* GetField() const {WaitField(); return fMap;}
+   TMagneticField* GetMagneticField() const {WaitField(); return fField;}
    double GetCentralField() const;
    void ScaleCentralFieldTo(double field);
 
-   bool IsGood() const {return !fStatus;}
+   bool IsGood() const {WaitField(); return !fStatus;}
+   // field lookup state of the traces, with cell cache counters
+   const TSamuraiFieldCursor& GetCursor() const {return fCursor;}
+   const Statistics& GetStatistics() const {return fStatistics;}
 
 private:
    int    fNMaxPoint;
    double fStep;             // step length (mm)
+   int    fPreviewLevel;     // field pyramid level
+   EPrecision fPrecision;    // arithmetic of TraceOneStep
+   EIntegrator fIntegrator;
+   double fPositionTolerance; // mm (kDormandPrince)
+   double fAngleTolerance;    // rad (kDormandPrince)
+   double fMaxStep;           // mm (kDormandPrince)
+   double fDriftMargin;       // mm
    double fRotationAngle;    // rotation angle for SAMURAI Magnet (deg)
    double fEndPlaneAngle;    // angle of end plane (deg)
    double fEndPlaneDistance; // distance of end plane (mm)
 
-   TSamuraiMagnetField *fField;
+   TMagneticField *fField;
+   TSamuraiMagnetField *fMap; // = fField if it is a field map
+   TSamuraiFieldCursor fCursor;
    std::vector<double> fX; // should be std::array<double> in C++11
    std::vector<double> fY; // should be std::array<double> in C++11
    std::vector<double> fZ; // should be std::array<double> in C++11
    double fFlightLength;
+   Statistics fStatistics;
 
-   /* temporary variables */
+   struct Condition {
+      enum EType { kPlane, kRectangle, kMaxLength, kMaxBend };
+      EType       fType;
+      EAction     fAction;
+      std::string fName;
+      double      fLab[5];       // parameters as given
+      /* magnet frame, set up by SetFrame() */
+      double      fNormal[2];    // planes: unit normal
+      double      fDistance;     //   and distance from the origin
+      double      fTangent[2];   // rectangles: horizontal direction
+      double      fCenter[2];
+      double      fHalfWidth;
+      double      fHalfHeight;   //   (<= 0: unbounded)
+      double      fLimit;        // flight length, cos(bend)
+   };
+   std::vector<Condition> fConditions;
+   Condition fEndPlane;
+   std::vector<Crossing> fCrossings;
+   int fStopCondition;
+
+   /* temporary variables, in the magnet frame during Trace() */
    std::vector<double> fPosition;
    std::vector<double> fMomentum;
-   std::vector<double> fB;
-   std::vector<double> fRNew;
-   std::vector<double> fDX;
-   std::vector<double> fP1;
-   std::vector<double> fP2;
-   std::vector<double> fPNew;
+   double fFrameCos;          // cos(fRotationAngle)
+   double fFrameSin;          // sin(fRotationAngle)
+   double fPath;              // flight length so far (mm)
+   double fStartDirection[3]; // unit momentum at the start
+   bool   fHasBounds;         // field bounds known
+   double fBoundsMin[3];      // field bounds + margin (magnet frame)
+   double fBoundsMax[3];
 
    double fCharge;
    int fStatus; // TODO: define status code
 
-   void TraceOneStep();
-   double DistanceToEndPlane() const;
-   void ReadMagneticFieldAt(const std::vector<double> &x,
-			    double *b) const;
+   struct AsyncLoad;
+   mutable AsyncLoad *fPending; // field being loaded in background
+
+   bool AcceptField(TSamuraiMagnetField *field, const char* filename);
+   void WaitField() const;
+   static void* LoadThread(void *arg);
+   template <class Precision> void TraceOneStep();
+   bool TraceAdaptive();
+   // d(r,u)/ds for the state (position, unit momentum) y
+   void Derivative(const double y[], double kappa, double dy[]);
+   double Step() const {return fStep * (1 << fPreviewLevel);}
+   // magnet frame: the lab frame rotated by fRotationAngle, whose x, y
+   // and z are the x, z and y of the map
+   void SetFrame();
+   void ToMagnetFrame(const double v[], double *w) const;
+   void ToLabFrame();
+   // straight steps from the current state while they stay out of the
+   // field bounds, up to the first one crossing a condition; returns
+   // the number taken (at most nMax), *stopped if a kStop condition
+   // ended the trace
+   int Drift(double step, int nMax, bool *stopped);
+
+   // the step just taken, for locating conditions met within it
+   struct Span {
+      double fR0[3], fU0[3]; // position, unit momentum at the start
+      double fR1[3], fU1[3]; // and at the end
+      double fS0;            // flight length at the start
+      double fH;             // step length
+      const double *fCont;   // [5][6] continuous extension, or NULL:
+			     // cubic Hermite of the end points
+   };
+   int AddCondition(Condition::EType type, EAction action,
+		    const char *name, const double lab[], int nLab);
+   void Orient(Condition *condition) const;
+   // position and unit momentum at theta (0..1) of span
+   static void Interpolate(const Span &span, double theta,
+			   double r[], double u[]);
+   // > 0 before the condition is met, < 0 after
+   double Value(const Condition &condition, const double r[],
+		const double u[], double s) const;
+   // record and stop at the conditions met in span; true if stopped
+   bool CheckConditions(const Span &span);
+   void ReadMagneticFieldAt(const double x[], double *b);
+   void SetLookAhead(const double p[], double length);
 
    TSamuraiTracer(const TSamuraiTracer&);            // undefined
    TSamuraiTracer& operator=(const TSamuraiTracer&); // undefined
@@ -0,0 +1,493 @@
+/**
+ * @file   fieldbench.cc
+ * @brief  measure the cost of TSamuraiMagnetField::Eval and EvalN, and
+ *         the tracing accuracy against the step length
+ *
+ * @date   Created       : 2026-10-17 17:21:06 JST
+ *         Last Modified : 2026-10-17 17:21:06 JST (kawase)
+ * @author KAWASE Shoichiro <kawase@aees.kyushu-u.ac.jp>
+ *
+ *    (C) 2016 KAWASE Shoichiro
+ */
+
+#include "TSamuraiMagnetField.h"
+#include "TSamuraiFieldCubic.h"
+#include "TSamuraiTracer.h"
+#include "TEngeDipoleField.h"
+#include "TSamuraiFieldStats.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include <time.h>
+#include <unistd.h>
+
+using art::TEngeDipoleField;
+using art::TMagneticField;
+using art::TSamuraiFieldFile;
+using art::TSamuraiMagnetField;
+using art::TSamuraiTracer;
+
+namespace {
+   void Usage()
+   {
+      printf("usage: fieldbench [-h] [-n points] [-r repeat] [-s seed] <map file> [map name]\n");
+      printf("       fieldbench -t [-e tolerance] <map file> [map name]\n");
+      printf("       fieldbench -p <map file> [map name]\n");
+   }
+
+   double Now()
+   {
+      struct timespec ts;
+      clock_gettime(CLOCK_MONOTONIC,&ts);
+      return ts.tv_sec + 1e-9 * ts.tv_nsec;
+   }
+
+   struct Result {
+      double fNsPerEval;
+      std::vector<double> fB;
+   };
+
+   // evaluate all points repeat times, keep the field of the last pass
+   Result Run(const TMagneticField &field, const std::vector<double> &x,
+	      int repeat)
+   {
+      Result result;
+      const size_t n = x.size() / 3;
+      result.fB.resize(3 * n);
+      const double start = Now();
+      for (int r = 0; r != repeat; ++r) {
+	 for (size_t i = 0; i != n; ++i) {
+	    field.Eval(x[3*i],x[3*i+1],x[3*i+2],
+		       &result.fB[3*i],&result.fB[3*i+1],&result.fB[3*i+2]);
+	 }
+      }
+      result.fNsPerEval = 1e9 * (Now() - start) / ((double)n * repeat);
+      return result;
+   }
+
+   // the same through EvalN in batches of kBatch points
+   Result RunN(const TSamuraiMagnetField &field, const std::vector<double> &x,
+	       int repeat)
+   {
+      static const size_t kBatch = 256;
+      Result result;
+      const size_t n = x.size() / 3;
+      std::vector<double> in(3 * n), out(3 * n);
+      for (size_t i = 0; i != n; ++i) {
+	 for (int axis = 0; axis != 3; ++axis) in[axis * n + i] = x[3*i+axis];
+      }
+      const double start = Now();
+      for (int r = 0; r != repeat; ++r) {
+	 for (size_t i = 0; i < n; i += kBatch) {
+	    const size_t m = std::min(kBatch,n - i);
+	    field.EvalN(m,&in[i],&in[n+i],&in[2*n+i],
+			&out[i],&out[n+i],&out[2*n+i]);
+	 }
+      }
+      result.fNsPerEval = 1e9 * (Now() - start) / ((double)n * repeat);
+      result.fB.resize(3 * n);
+      for (size_t i = 0; i != n; ++i) {
+	 for (int axis = 0; axis != 3; ++axis) result.fB[3*i+axis] = out[axis * n + i];
+      }
+      return result;
+   }
+
+   // EvalWithGradient against central differences of Eval: ns per
+   // point of each and the largest difference (T/mm)
+   void RunGradient(const TSamuraiMagnetField &field,
+		    const std::vector<double> &x, int repeat,
+		    double *nsGradient, double *nsDifference, double *maxDiff)
+   {
+      static const double h = 1e-3; // mm
+      const size_t n = x.size() / 3;
+      std::vector<double> grad(9 * n), diff(9 * n);
+      double b[3], bp[3], bm[3];
+      double start = Now();
+      for (int r = 0; r != repeat; ++r) {
+	 for (size_t i = 0; i != n; ++i) {
+	    field.EvalWithGradient(x[3*i],x[3*i+1],x[3*i+2],b,
+				   (double(*)[3])&grad[9*i]);
+	 }
+      }
+      *nsGradient = 1e9 * (Now() - start) / ((double)n * repeat);
+
+      start = Now();
+      for (int r = 0; r != repeat; ++r) {
+	 for (size_t i = 0; i != n; ++i) {
+	    field.Eval(x[3*i],x[3*i+1],x[3*i+2],b,b+1,b+2);
+	    for (int axis = 0; axis != 3; ++axis) {
+	       double xp[3] = {x[3*i],x[3*i+1],x[3*i+2]};
+	       double xm[3] = {x[3*i],x[3*i+1],x[3*i+2]};
+	       xp[axis] += h;
+	       xm[axis] -= h;
+	       field.Eval(xp[0],xp[1],xp[2],bp,bp+1,bp+2);
+	       field.Eval(xm[0],xm[1],xm[2],bm,bm+1,bm+2);
+	       for (int c = 0; c != 3; ++c) {
+		  diff[9*i + 3*c + axis] = (bp[c] - bm[c]) / (2 * h);
+	       }
+	    }
+	 }
+      }
+      *nsDifference = 1e9 * (Now() - start) / ((double)n * repeat);
+
+      *maxDiff = 0.;
+      for (size_t i = 0; i != grad.size(); ++i) {
+	 *maxDiff = std::max(*maxDiff,fabs(grad[i] - diff[i]));
+      }
+   }
+
+   // EvalN in single precision; fB is widened to compare with Run
+   Result RunNFloat(const TSamuraiMagnetField &field,
+		    const std::vector<double> &x, int repeat)
+   {
+      Result result;
+      const size_t n = x.size() / 3;
+      std::vector<float> xs(n), ys(n), zs(n), bx(n), by(n), bz(n);
+      for (size_t i = 0; i != n; ++i) {
+	 xs[i] = x[3*i];
+	 ys[i] = x[3*i+1];
+	 zs[i] = x[3*i+2];
+      }
+      const double start = Now();
+      for (int r = 0; r != repeat; ++r) {
+	 field.EvalN(n,&xs[0],&ys[0],&zs[0],&bx[0],&by[0],&bz[0]);
+      }
+      result.fNsPerEval = 1e9 * (Now() - start) / ((double)n * repeat);
+      result.fB.resize(3 * n);
+      for (size_t i = 0; i != n; ++i) {
+	 result.fB[3*i]   = bx[i];
+	 result.fB[3*i+1] = by[i];
+	 result.fB[3*i+2] = bz[i];
+      }
+      return result;
+   }
+
+   double MaxDiff(const Result &a, const Result &b)
+   {
+      double maxDiff = 0.;
+      for (size_t i = 0; i != a.fB.size(); ++i) {
+	 maxDiff = std::max(maxDiff,fabs(a.fB[i] - b.fB[i]));
+      }
+      return maxDiff;
+   }
+
+   /* tracing benchmark: the setup of trace with sample/ */
+   const double kMagnetAngle = -30.;     // deg
+   const double kEndPlaneAngle = -60.;   // deg
+   const double kEndPlaneDistance = 6750; // mm
+   const double kTarget[3] = {0.,-4000.,0.};
+   const double kMaxLength = 20000.;     // mm
+   const double kReferenceStep = 1.;     // mm
+   const double kSteps[] = {2.,5.,10.,20.,50.,100.,200.};
+   const double kTolerances[] = {1.,1e-1,1e-2,1e-3,1e-4}; // mm
+   const double kAnglePerPosition = 1e-3; // rad/mm of the tolerances
+
+   struct Track {
+      double fZ;
+      double fA;
+      double fPerA;  // MeV/c/u
+      double fTheta; // deg
+   };
+   const Track kTracks[] = {
+      { 34, 79, 434.52,  0.  },
+      { 34, 79, 434.52, -2.5 },
+      { 34, 79, 434.52,  2.5 },
+      { 34, 73, 431.79,  0.  },
+   };
+   const int kNTrack = sizeof(kTracks) / sizeof(kTracks[0]);
+
+   struct Traced {
+      double fX[kNTrack];      // end plane crossing along the plane (mm)
+      double fLength[kNTrack]; // flight length (mm)
+      double fEval;            // field lookups per track
+      double fMsPerTrack;
+   };
+
+   bool TraceAll(TSamuraiTracer *tracer, double step, Traced *traced)
+   {
+      const double pi = 3.14159265359;
+      const double deg2rad = pi / 180.;
+      const double c = cos(kEndPlaneAngle * deg2rad);
+      const double s = sin(kEndPlaneAngle * deg2rad);
+      tracer->SetStepLength(step);
+      tracer->SetMaxPoint((int)(kMaxLength / step) + 1);
+
+      unsigned long nEval = 0;
+      const double start = Now();
+      for (int t = 0; t != kNTrack; ++t) {
+	 const Track &track = kTracks[t];
+	 const double p = track.fPerA * track.fA;
+	 const double mom[3] = {-p * sin(track.fTheta * deg2rad),
+				p * cos(track.fTheta * deg2rad),0.};
+	 if (!tracer->Trace(kTarget,mom,track.fZ)) return false;
+
+	 /* back from the last point to the end plane along the last step */
+	 const std::vector<double> &x = tracer->GetXArray();
+	 const std::vector<double> &y = tracer->GetYArray();
+	 const size_t n = x.size();
+	 if (n < 2) return false;
+	 const double u1 = -x[n-1]*s + y[n-1]*c;
+	 const double u0 = -x[n-2]*s + y[n-2]*c;
+	 const double f = (kEndPlaneDistance - u0) / (u1 - u0);
+	 const double xc = x[n-2] + f * (x[n-1] - x[n-2]);
+	 const double yc = y[n-2] + f * (y[n-1] - y[n-2]);
+	 traced->fX[t] = xc*c + yc*s;
+	 traced->fLength[t] = tracer->GetFlightLength();
+	 nEval += tracer->GetStatistics().fEvals;
+      }
+      traced->fMsPerTrack = 1e3 * (Now() - start) / kNTrack;
+      traced->fEval = (double)nEval / kNTrack;
+      return true;
+   }
+
+   // end plane accuracy of trilinear and tricubic field against the
+   // step length and the tolerance of adaptive steps, each compared
+   // with its own kReferenceStep trace
+   int TraceBench(const char* filename, const char* mapName, double tolerance)
+   {
+      TSamuraiTracer tracer;
+      if (!tracer.LoadField(filename,mapName)) return -2;
+      tracer.SetRotationAngle(kMagnetAngle);
+      tracer.SetEndPlane(kEndPlaneDistance,kEndPlaneAngle);
+
+      static const char *const kName[] = {"trilinear","tricubic"};
+      double largest[2] = {0.,0.};
+      double evals[2] = {0.,0.};
+      for (int mode = 0; mode != 2; ++mode) {
+	 tracer.GetField()->SetInterpolation(mode ? TSamuraiMagnetField::kTricubic
+					     : TSamuraiMagnetField::kTrilinear);
+	 Traced reference;
+	 if (!TraceAll(&tracer,kReferenceStep,&reference)) {
+	    printf("%s: tracks do not reach the end plane\n",kName[mode]);
+	    return -3;
+	 }
+	 printf("%s (against %g mm steps)\n",kName[mode],kReferenceStep);
+	 printf("   step   max |dx|   max |dL|  Eval/track  ms/track\n");
+	 for (size_t i = 0; i != sizeof(kSteps) / sizeof(kSteps[0]); ++i) {
+	    Traced traced;
+	    if (!TraceAll(&tracer,kSteps[i],&traced)) continue;
+	    double dx = 0., dl = 0.;
+	    for (int t = 0; t != kNTrack; ++t) {
+	       dx = std::max(dx,fabs(traced.fX[t] - reference.fX[t]));
+	       dl = std::max(dl,fabs(traced.fLength[t] - reference.fLength[t]));
+	    }
+	    printf("  %5g  %9.3g  %9.3g  %10.0f  %8.3f\n",
+		   kSteps[i],dx,dl,traced.fEval,traced.fMsPerTrack);
+	    if (dx < tolerance) {
+	       largest[mode] = kSteps[i];
+	       evals[mode] = traced.fEval;
+	    }
+	 }
+
+	 printf("    tol   max |dx|   max |dL|  Eval/track  ms/track (adaptive)\n");
+	 tracer.SetIntegrator(TSamuraiTracer::kDormandPrince);
+	 for (size_t i = 0; i != sizeof(kTolerances) / sizeof(kTolerances[0]); ++i) {
+	    tracer.SetTolerance(kTolerances[i],kTolerances[i] * kAnglePerPosition);
+	    Traced traced;
+	    if (!TraceAll(&tracer,kReferenceStep,&traced)) continue;
+	    double dx = 0., dl = 0.;
+	    for (int t = 0; t != kNTrack; ++t) {
+	       dx = std::max(dx,fabs(traced.fX[t] - reference.fX[t]));
+	       dl = std::max(dl,fabs(traced.fLength[t] - reference.fLength[t]));
+	    }
+	    printf("  %5g  %9.3g  %9.3g  %10.0f  %8.3f\n",
+		   kTolerances[i],dx,dl,traced.fEval,traced.fMsPerTrack);
+	 }
+	 tracer.SetIntegrator(TSamuraiTracer::kFixedStep);
+      }
+      for (int mode = 0; mode != 2; ++mode) {
+	 if (largest[mode] > 0.) {
+	    printf("%s: |dx| < %g mm up to %g mm steps, %.0f Eval/track\n",
+		   kName[mode],tolerance,largest[mode],evals[mode]);
+	 } else {
+	    printf("%s: |dx| < %g mm not reached\n",kName[mode],tolerance);
+	 }
+      }
+      return 0;
+   }
+
+   // end plane deviation and cost of single precision steps against
+   // double precision steps of the same length
+   int PrecisionBench(const char* filename, const char* mapName)
+   {
+      TSamuraiTracer tracer;
+      if (!tracer.LoadField(filename,mapName)) return -2;
+      tracer.SetRotationAngle(kMagnetAngle);
+      tracer.SetEndPlane(kEndPlaneDistance,kEndPlaneAngle);
+
+      printf("float steps against double steps\n");
+      printf("   step   max |dx|   max |dL|  ms/track (double)  ms/track (float)\n");
+      for (size_t i = 0; i != sizeof(kSteps) / sizeof(kSteps[0]); ++i) {
+	 Traced reference, traced;
+	 tracer.SetPrecision(TSamuraiTracer::kDouble);
+	 if (!TraceAll(&tracer,kSteps[i],&reference)) continue;
+	 tracer.SetPrecision(TSamuraiTracer::kSingle);
+	 if (!TraceAll(&tracer,kSteps[i],&traced)) {
+	    printf("  %5g  float tracks do not reach the end plane\n",kSteps[i]);
+	    continue;
+	 }
+	 double dx = 0., dl = 0.;
+	 for (int t = 0; t != kNTrack; ++t) {
+	    dx = std::max(dx,fabs(traced.fX[t] - reference.fX[t]));
+	    dl = std::max(dl,fabs(traced.fLength[t] - reference.fLength[t]));
+	 }
+	 printf("  %5g  %9.3g  %9.3g  %17.3f  %16.3f\n",kSteps[i],dx,dl,
+		reference.fMsPerTrack,traced.fMsPerTrack);
+      }
+      return 0;
+   }
+}
+
+int main(int argc, char* argv[])
+{
+   int nPoint = 1000000;
+   int repeat = 5;
+   unsigned seed = 1;
+   bool trace = false;
+   bool precision = false;
+   double tolerance = 0.1; // mm
+
+   int opt;
+   while ((opt = getopt(argc,argv,"hn:r:s:tpe:")) != -1) {
+      switch (opt) {
+	 case 'p':
+	    precision = true;
+	    break;
+	 case 't':
+	    trace = true;
+	    break;
+	 case 'e':
+	    tolerance = atof(optarg);
+	    break;
+	 case 'n':
+	    nPoint = atoi(optarg);
+	    break;
+	 case 'r':
+	    repeat = atoi(optarg);
+	    break;
+	 case 's':
+	    seed = atoi(optarg);
+	    break;
+	 case 'h':
+	    Usage();
+	    return 0;
+	 default:
+	    Usage();
+	    return -1;
+      }
+   }
+   if (optind == argc || nPoint <= 0 || repeat <= 0) {
+      Usage();
+      return -1;
+   }
+   if (precision) {
+      return PrecisionBench(argv[optind],optind + 1 < argc ? argv[optind+1] : "");
+   }
+   if (trace) {
+      return TraceBench(argv[optind],optind + 1 < argc ? argv[optind+1] : "",
+			tolerance);
+   }
+
+   TSamuraiMagnetField field(argv[optind],optind + 1 < argc ? argv[optind+1] : "");
+   if (!field.IsGood()) return -2;
+   const TSamuraiFieldFile::Entry &info = field.GetInfo();
+
+   /* random points inside the map, mirrored half included */
+   srand(seed);
+   std::vector<double> x(3 * (size_t)nPoint);
+   const double xmax = info.fX0 + info.fDx * (info.fNx - 1);
+   const double ymin = info.fY0, ymax = info.fY0 + info.fDy * (info.fNy - 1);
+   const double zmax = info.fZ0 + info.fDz * (info.fNz - 1);
+   for (int i = 0; i != nPoint; ++i) {
+      x[3*i]   = (2. * rand() / RAND_MAX - 1.) * xmax;
+      x[3*i+1] = ymin + (ymax - ymin) * rand() / RAND_MAX;
+      x[3*i+2] = (2. * rand() / RAND_MAX - 1.) * zmax;
+   }
+
+   /* warm up the page cache */
+   Run(field,x,1);
+
+   field.SetGeneric(true);
+   const Result generic = Run(field,x,repeat);
+   field.SetGeneric(false);
+   const Result special = Run(field,x,repeat);
+
+   printf("%d points x %d: generic %.1f ns/Eval",nPoint,repeat,generic.fNsPerEval);
+   if (!field.IsSpecialized()) {
+      printf(", no fixed-grid kernel for %dx%dx%d @ (%g,%g,%g) mm\n",
+	     info.fNx,info.fNy,info.fNz,info.fDx,info.fDy,info.fDz);
+   } else {
+      printf(", fixed grid %.1f ns/Eval (x%.2f), max |dB| = %.2g T\n",
+	     special.fNsPerEval,generic.fNsPerEval / special.fNsPerEval,
+	     MaxDiff(generic,special));
+   }
+
+   /* EvalN against the generic path; the vector kernels reproduce it bit for bit */
+   static const struct {
+      TSamuraiMagnetField::EVectorISA fISA;
+      const char *fName;
+   } kISA[] = {
+      { TSamuraiMagnetField::kScalar, "scalar" },
+      { TSamuraiMagnetField::kAVX2,   "AVX2" },
+      { TSamuraiMagnetField::kAVX512, "AVX-512" },
+   };
+   const TSamuraiMagnetField::EVectorISA best = field.GetVectorISA();
+   for (size_t i = 0; i != sizeof(kISA) / sizeof(kISA[0]); ++i) {
+      if (kISA[i].fISA > best) break;
+      field.SetVectorISA(kISA[i].fISA);
+      const Result batch = RunN(field,x,repeat);
+      printf("  EvalN %-7s %.1f ns/point (x%.2f), max |dB| = %.2g T\n",
+	     kISA[i].fName,batch.fNsPerEval,
+	     generic.fNsPerEval / batch.fNsPerEval,MaxDiff(generic,batch));
+      const Result single = RunNFloat(field,x,repeat);
+      printf("  EvalN %-7s %.1f ns/point in float (x%.2f), max |dB| = %.2g T\n",
+	     kISA[i].fName,single.fNsPerEval,
+	     generic.fNsPerEval / single.fNsPerEval,MaxDiff(generic,single));
+   }
+   field.SetVectorISA(best);
+
+   /* central differences of a trilinear field break down at cell faces:
+      compare the cost only */
+   double nsGradient, nsDifference, maxGradDiff;
+   RunGradient(field,x,repeat,&nsGradient,&nsDifference,&maxGradDiff);
+   printf("  gradient %.1f ns/EvalWithGradient, %.1f ns by central differences (x%.2f)\n",
+	  nsGradient,nsDifference,nsDifference / nsGradient);
+
+   /* analytic model fitted to the midplane; its expansion in y is of
+      second order, so it is compared to the map on the midplane only */
+   TEngeDipoleField enge;
+   double rms = 0.;
+   if (enge.Fit(field,6,&rms)) {
+      const Result model = Run(enge,x,repeat);
+      std::vector<double> midplane(x);
+      for (size_t i = 1; i < midplane.size(); i += 3) midplane[i] = 0.;
+      printf("  Enge model %.1f ns/Eval, midplane rms %.2g T, max |dB| = %.2g T against the map on the midplane\n",
+	     model.fNsPerEval,rms,
+	     MaxDiff(Run(field,midplane,1),Run(enge,midplane,1)));
+   }
+
+   /* tricubic: random points mostly miss the coefficient cache */
+   field.SetInterpolation(TSamuraiMagnetField::kTricubic);
+   const Result cubic = Run(field,x,repeat);
+   const art::TSamuraiFieldCubic *const coef = field.GetCubic();
+   printf("  tricubic %.1f ns/Eval, %.1f %% coefficient cache hits, max |dB| = %.2g T against trilinear\n",
+	  cubic.fNsPerEval,
+	  100. * coef->GetHits() / std::max(1UL,coef->GetHits() + coef->GetMisses()),
+	  MaxDiff(generic,cubic));
+
+   /* the tricubic field is C1, so central differences converge everywhere
+      but on the mirror planes */
+   RunGradient(field,x,1,&nsGradient,&nsDifference,&maxGradDiff);
+   printf("  tricubic gradient: max |dG| = %.2g T/mm against central differences\n",
+	  maxGradDiff);
+#ifdef SAMURAI_FIELD_STATS
+   if (const art::TSamuraiFieldStats *const stats = field.GetStats()) {
+      stats->Print();
+   }
+#endif
+   return 0;
+}
@@ -0,0 +1,445 @@
+/**
+ * @file   fieldconv.cc
+ * @brief  convert raw SAMURAI field maps into a field container
+ *
+ * @date   Created       : 2026-10-17 11:02:18 JST
+ *         Last Modified : 2026-10-17 11:02:18 JST (kawase)
+ * @author KAWASE Shoichiro <kawase@aees.kyushu-u.ac.jp>
+ *
+ *    (C) 2016 KAWASE Shoichiro
+ */
+
+#include "TSamuraiFieldFile.h"
+#include "TSamuraiFieldRegistry.h"
+
+#include <algorithm>
+#include <fstream>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+
+using art::TSamuraiFieldFile;
+using art::TSamuraiFieldRegistry;
+
+namespace {
+   void Usage()
+   {
+      printf("usage: fieldconv [-h] [-g nx,ny,nz] [-s dx,dy,dz] [-t tile] [-a] [-j threads] [-r] -o <output> <name>:<current>:<map> ...\n");
+      printf("       fieldconv [-g nx,ny,nz] [-s dx,dy,dz] [-a] [-j threads] -r -o <raw output> <map>\n");
+      printf("       fieldconv -l <container>\n");
+      printf("       fieldconv -c   (remove unused shared memory field segments)\n");
+      printf("  -a   maps are text tables of 'x y z Bx By Bz' (mm, T) instead of raw float dumps\n");
+      printf("  -j   threads to parse text tables with (default: all cores)\n");
+      printf("  -r   write a raw float dump of the single map instead of a container\n");
+   }
+
+   int List(const char* filename)
+   {
+      TSamuraiFieldFile file;
+      if (!file.Open(filename)) {
+	 fprintf(stderr,"%s is not a field container.\n",filename);
+	 return -1;
+      }
+
+      int nBad = 0;
+      for (int i = 0; i != file.GetNMaps(); ++i) {
+	 const TSamuraiFieldFile::Entry &e = file.GetEntry(i);
+	 const bool ok = file.Verify(i);
+	 printf("%-16s %8.2f A %7.4f T  %dx%dx%d @ (%g,%g,%g) mm  flags=%#x  %lu MB  %s\n",
+		e.fName,e.fCurrent,e.fCentralField,e.fNx,e.fNy,e.fNz,
+		e.fDx,e.fDy,e.fDz,e.fFlags,(unsigned long)(e.fSize >> 20),
+		ok ? "ok" : "CHECKSUM MISMATCH");
+	 if (!ok) ++nBad;
+      }
+      return nBad ? -2 : 0;
+   }
+
+   bool ReadRaw(const char* filename, size_t size, std::vector<float> *buf)
+   {
+      std::ifstream ifs(filename,std::ios::binary);
+      if (!ifs) {
+	 fprintf(stderr,"Cannot open file: %s\n",filename);
+	 return false;
+      }
+      ifs.seekg(0,std::fstream::end);
+      const size_t fileSize = ifs.tellg();
+      if (fileSize != size) {
+	 fprintf(stderr,"File size mismatch: %s (%lu while %lu expected)\n",
+		 filename,fileSize,size);
+	 return false;
+      }
+      ifs.seekg(0,std::fstream::beg);
+      buf->resize(size / sizeof(float));
+      ifs.read((char*)&(*buf)[0],size);
+      return ifs.good();
+   }
+
+   /* locale independent strtod for [-+]digits[.digits][eEdD[-+]digits] */
+   const char* ParseDouble(const char* p, const char* end, double *val)
+   {
+      static const double kPow10[] = {
+	 1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+	 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+      };
+      while (p != end && (*p == ' ' || *p == '\t' || *p == ',')) ++p;
+      const char* const begin = p;
+      bool negative = false;
+      if (p != end && (*p == '-' || *p == '+')) negative = (*p++ == '-');
+
+      unsigned long long mant = 0;
+      int exp10 = 0, nDigit = 0;
+      for (; p != end && '0' <= *p && *p <= '9'; ++p, ++nDigit) {
+	 if (mant < 100000000000000000ULL) mant = mant * 10 + (*p - '0');
+	 else ++exp10;
+      }
+      if (p != end && *p == '.') {
+	 for (++p; p != end && '0' <= *p && *p <= '9'; ++p, ++nDigit) {
+	    if (mant < 100000000000000000ULL) {
+	       mant = mant * 10 + (*p - '0');
+	       --exp10;
+	    }
+	 }
+      }
+      if (!nDigit) return begin;
+      if (p != end && (*p == 'e' || *p == 'E' || *p == 'd' || *p == 'D')) {
+	 const char* q = p + 1;
+	 bool negExp = false;
+	 if (q != end && (*q == '-' || *q == '+')) negExp = (*q++ == '-');
+	 int e = 0;
+	 const char* const digits = q;
+	 for (; q != end && '0' <= *q && *q <= '9'; ++q) {
+	    if (e < 10000) e = e * 10 + (*q - '0');
+	 }
+	 if (q != digits) {
+	    exp10 += negExp ? -e : e;
+	    p = q;
+	 }
+      }
+
+      double v = (double)mant;
+      if (0 <= exp10 && exp10 <= 22) v *= kPow10[exp10];
+      else if (-22 <= exp10 && exp10 < 0) v /= kPow10[-exp10];
+      else if (mant) v *= pow(10.,exp10);
+      *val = negative ? -v : v;
+      return p;
+   }
+
+   struct TextChunk {
+      const char *fBegin, *fEnd;
+      const TSamuraiFieldFile::Entry *fEntry;
+      float *fData;
+      uint64_t *fFilled; // bitmap of the nodes set by this chunk
+      size_t fNLines, fNPoints, fNOutside, fNOffGrid, fNDuplicate;
+   };
+
+   // node index of coordinate v, -1 if outside, -2 if between nodes
+   inline long GridIndex(double v, double v0, double d, int n)
+   {
+      const double u = (v - v0) / d;
+      const long i = (long)floor(u + 0.5);
+      if (fabs(u - i) > 1e-3) return -2;
+      return (0 <= i && i < n) ? i : -1;
+   }
+
+   void* ParseTextChunk(void *arg)
+   {
+      TextChunk *const c = static_cast<TextChunk*>(arg);
+      const TSamuraiFieldFile::Entry &e = *c->fEntry;
+      const char *p = c->fBegin;
+      while (p != c->fEnd) {
+	 const char *eol = static_cast<const char*>(memchr(p,'\n',c->fEnd - p));
+	 if (!eol) eol = c->fEnd;
+	 ++c->fNLines;
+
+	 double v[6];
+	 int n = 0;
+	 for (const char *q = p; n != 6; ++n) {
+	    const char *const next = ParseDouble(q,eol,&v[n]);
+	    if (next == q) break;
+	    q = next;
+	 }
+	 p = eol == c->fEnd ? eol : eol + 1;
+	 if (n != 6) continue; // header, comment or blank line
+	 ++c->fNPoints;
+
+	 const long i = GridIndex(v[0],e.fX0,e.fDx,e.fNx);
+	 const long j = GridIndex(v[1],e.fY0,e.fDy,e.fNy);
+	 const long k = GridIndex(v[2],e.fZ0,e.fDz,e.fNz);
+	 if (i == -2 || j == -2 || k == -2) {
+	    ++c->fNOffGrid;
+	    continue;
+	 }
+	 if (i < 0 || j < 0 || k < 0) {
+	    ++c->fNOutside; // e.g. the mirrored half of a full map
+	    continue;
+	 }
+	 const size_t node = ((size_t)i * e.fNy + j) * e.fNz + k;
+	 uint64_t &word = c->fFilled[node >> 6];
+	 const uint64_t bit = (uint64_t)1 << (node & 63);
+	 if (word & bit) ++c->fNDuplicate;
+	 word |= bit;
+	 float *const b = c->fData + 3 * node;
+	 b[0] = v[3];
+	 b[1] = v[4];
+	 b[2] = v[5];
+      }
+      return NULL;
+   }
+
+   // parse a text table into the [nx][ny][nz][3] grid of entry
+   bool ReadText(const char* filename, const TSamuraiFieldFile::Entry &entry,
+		 int nThread, std::vector<float> *buf)
+   {
+      struct timeval t0, t1;
+      gettimeofday(&t0,NULL);
+
+      const int fd = open(filename,O_RDONLY);
+      struct stat st;
+      if (fd < 0 || fstat(fd,&st)) {
+	 fprintf(stderr,"Cannot open file: %s\n",filename);
+	 if (fd >= 0) close(fd);
+	 return false;
+      }
+      const size_t size = st.st_size;
+      const char *const text = size ? static_cast<const char*>
+	 (mmap(NULL,size,PROT_READ,MAP_PRIVATE,fd,0)) : NULL;
+      close(fd);
+      if (!text || text == MAP_FAILED) {
+	 fprintf(stderr,"Cannot map file: %s\n",filename);
+	 return false;
+      }
+      madvise(const_cast<char*>(text),size,MADV_SEQUENTIAL);
+
+      const size_t nNode = (size_t)entry.fNx * entry.fNy * entry.fNz;
+      buf->assign(3 * nNode,0.f);
+      const size_t nWord = (nNode + 63) / 64;
+      std::vector<uint64_t> bitmaps(nThread * nWord,0);
+
+      /* split at line boundaries */
+      std::vector<TextChunk> chunks(nThread);
+      const char *begin = text;
+      for (int t = 0; t != nThread; ++t) {
+	 const char *end = text + size * (t + 1) / nThread;
+	 if (end < begin) end = begin;
+	 while (end != text + size && end != text && end[-1] != '\n') ++end;
+	 TextChunk c = { begin, end, &entry, &(*buf)[0], &bitmaps[t * nWord],
+			 0, 0, 0, 0, 0 };
+	 chunks[t] = c;
+	 begin = end;
+      }
+
+      std::vector<pthread_t> threads(nThread);
+      std::vector<bool> started(nThread,false);
+      for (int t = 1; t < nThread; ++t) {
+	 started[t] = !pthread_create(&threads[t],NULL,ParseTextChunk,&chunks[t]);
+      }
+      ParseTextChunk(&chunks[0]);
+      for (int t = 1; t < nThread; ++t) {
+	 if (started[t]) pthread_join(threads[t],NULL);
+	 else ParseTextChunk(&chunks[t]);
+      }
+
+      TextChunk sum = { NULL, NULL, NULL, NULL, NULL, 0, 0, 0, 0, 0 };
+      for (int t = 0; t != nThread; ++t) {
+	 sum.fNLines     += chunks[t].fNLines;
+	 sum.fNPoints    += chunks[t].fNPoints;
+	 sum.fNOutside   += chunks[t].fNOutside;
+	 sum.fNOffGrid   += chunks[t].fNOffGrid;
+	 sum.fNDuplicate += chunks[t].fNDuplicate;
+      }
+
+      /* merge the bitmaps; nodes set by several chunks are duplicates too */
+      std::vector<uint64_t> filled(bitmaps.begin(),bitmaps.begin() + nWord);
+      size_t nShared = 0;
+      for (int t = 1; t < nThread; ++t) {
+	 const uint64_t *const words = &bitmaps[t * nWord];
+	 for (size_t w = 0; w != nWord; ++w) {
+	    nShared += __builtin_popcountll(filled[w] & words[w]);
+	    filled[w] |= words[w];
+	 }
+      }
+      sum.fNDuplicate += nShared;
+      if (nShared) {
+	 /* which chunk wrote such a node last is up to the threads: read
+	    the chunks again in file order, so that the last line wins */
+	 for (int t = 0; t != nThread; ++t) {
+	    TextChunk c = chunks[t];
+	    ParseTextChunk(&c);
+	 }
+      }
+      munmap(const_cast<char*>(text),size);
+
+      size_t nFilled = 0;
+      for (size_t w = 0; w != nWord; ++w) {
+	 nFilled += __builtin_popcountll(filled[w]);
+      }
+
+      gettimeofday(&t1,NULL);
+      const double sec = (t1.tv_sec - t0.tv_sec) + 1e-6 * (t1.tv_usec - t0.tv_usec);
+      printf("%s: %lu lines, %lu points, %lu outside the grid, %lu off the mesh, %lu duplicated (%.1f s, %.0f MB/s, %d threads)\n",
+	     filename,sum.fNLines,sum.fNPoints,sum.fNOutside,sum.fNOffGrid,
+	     sum.fNDuplicate,sec,size / 1048576. / (sec > 0 ? sec : 1),nThread);
+
+      if (nFilled != nNode) {
+	 size_t node = 0;
+	 while (filled[node >> 6] >> (node & 63) & 1) ++node;
+	 fprintf(stderr,"%s: %lu of %lu grid nodes missing, first at (%g,%g,%g) mm\n",
+		 filename,nNode - nFilled,nNode,
+		 entry.fX0 + entry.fDx * (node / ((size_t)entry.fNy * entry.fNz)),
+		 entry.fY0 + entry.fDy * (node / entry.fNz % entry.fNy),
+		 entry.fZ0 + entry.fDz * (node % entry.fNz));
+	 return false;
+      }
+      return true;
+   }
+
+   bool WriteRaw(const char* filename, const std::vector<float> &buf)
+   {
+      std::ofstream ofs(filename,std::ios::binary);
+      ofs.write((const char*)&buf[0],sizeof(float) * buf.size());
+      return ofs.good();
+   }
+}
+
+int main(int argc, char* argv[])
+{
+   int nx = 301, ny = 81, nz = 301;
+   double dx = 10, dy = 10, dz = 10;
+   const char* output = NULL;
+   int tile = 0;
+   bool text = false;
+   bool raw = false;
+   int nThread = sysconf(_SC_NPROCESSORS_ONLN);
+
+   int opt;
+   while ((opt = getopt(argc,argv,"acg:hj:l:o:rs:t:")) != -1) {
+      switch (opt) {
+	 case 'g':
+	    if (sscanf(optarg,"%d,%d,%d",&nx,&ny,&nz) != 3) {
+	       Usage();
+	       return -1;
+	    }
+	    break;
+	 case 's':
+	    if (sscanf(optarg,"%lf,%lf,%lf",&dx,&dy,&dz) != 3) {
+	       Usage();
+	       return -1;
+	    }
+	    break;
+	 case 't':
+	    tile = atoi(optarg);
+	    if (tile <= 0) {
+	       Usage();
+	       return -1;
+	    }
+	    break;
+	 case 'a':
+	    text = true;
+	    break;
+	 case 'j':
+	    nThread = atoi(optarg);
+	    break;
+	 case 'r':
+	    raw = true;
+	    break;
+	 case 'o':
+	    output = optarg;
+	    break;
+	 case 'l':
+	    return List(optarg);
+	 case 'c':
+	    printf("%d stale segment(s) removed\n",
+		   TSamuraiFieldRegistry::CleanupStale());
+	    return 0;
+	 case 'h':
+	    Usage();
+	    return 0;
+	 default:
+	    Usage();
+	    return -1;
+      }
+   }
+
+   if (!output || optind == argc || (raw && (argc - optind != 1 || tile))) {
+      Usage();
+      return -1;
+   }
+   if (nThread < 1) nThread = 1;
+
+   const int nMaps = argc - optind;
+   std::vector<TSamuraiFieldFile::Entry> entries(nMaps);
+   std::vector<std::vector<float> > buffers(nMaps);
+   std::vector<std::vector<char> > tiles(nMaps);
+   std::vector<const void*> data(nMaps);
+
+   for (int i = 0; i != nMaps; ++i) {
+      const std::string spec = argv[optind + i];
+      const size_t c1 = spec.find(':');
+      const size_t c2 = c1 == std::string::npos ? c1 : spec.find(':',c1+1);
+      std::string name, file = spec;
+      double current = 0.;
+      if (c2 != std::string::npos) {
+	 name    = spec.substr(0,c1);
+	 current = atof(spec.substr(c1+1,c2-c1-1).c_str());
+	 file    = spec.substr(c2+1);
+      } else if (!raw) { // -r also takes a bare file name
+	 fprintf(stderr,"Bad map specification: %s\n",spec.c_str());
+	 Usage();
+	 return -1;
+      }
+
+      TSamuraiFieldFile::Entry &e = entries[i];
+      memset(&e,0,sizeof(e));
+      strncpy(e.fName,name.c_str(),TSamuraiFieldFile::kNameLength - 1);
+      TSamuraiFieldFile::SetLegacyGeometry(&e,nx,ny,nz,dx,dy,dz);
+      e.fCurrent = current;
+
+      if (text ? !ReadText(file.c_str(),e,nThread,&buffers[i])
+	  : !ReadRaw(file.c_str(),e.fSize,&buffers[i])) {
+	 return -2;
+      }
+      data[i] = &buffers[i][0];
+
+      /* By at node (0,ny/2,0) */
+      e.fCentralField = buffers[i][(size_t)(ny / 2) * nz * 3 + 1];
+
+      if (tile) {
+	 if (!TSamuraiFieldFile::EncodeTiles(&buffers[i][0],e,tile,&tiles[i])) {
+	    fprintf(stderr,"Failed to compress %s\n",file.c_str());
+	    return -2;
+	 }
+	 std::vector<float>().swap(buffers[i]);
+	 e.fFlags |= TSamuraiFieldFile::kTiled;
+	 e.fSize = tiles[i].size();
+	 data[i] = &tiles[i][0];
+      }
+      printf("%-16s %8.2f A %7.4f T <= %s\n",
+	     e.fName,e.fCurrent,e.fCentralField,file.c_str());
+   }
+
+   if (raw) {
+      if (!WriteRaw(output,buffers[0])) {
+	 fprintf(stderr,"Failed to write %s\n",output);
+	 return -3;
+      }
+      printf("raw map written to %s\n",output);
+      return 0;
+   }
+
+   if (!TSamuraiFieldFile::Write(output,entries,data)) {
+      fprintf(stderr,"Failed to write %s\n",output);
+      return -3;
+   }
+   printf("%d map(s) written to %s\n",nMaps,output);
+   return 0;
+}
@@ -1,4 +1,10 @@
 #include "TSamuraiTracer.h"
+#include "TSamuraiMagnetField.h"
+#include "TSamuraiFieldTiles.h"
+#include "TSamuraiFieldCubic.h"
+#include "TSamuraiFieldStats.h"
+#include "TEngeDipoleField.h"
+#include "TCompositeField.h"
 #include "traceUtil.h"
 #include "TGeneralConfig.h"
 #include "TGeometryConfig.h"
@@ -10,8 +16,103 @@
 #include <TObjArray.h>
 
 #include <fstream>
+#include <cstring>
+#include <string>
 #include <yaml-cpp/yaml.h>
 
+namespace {
+   // runs in the loader thread of TSamuraiTracer::LoadFieldAsync()
+   void SetupField(art::TSamuraiMagnetField *field, void *arg)
+   {
+      const trace::TMagnetConfig *const magConf =
+	 static_cast<const trace::TMagnetConfig*>(arg);
+      if (magConf->CurrentIsDefined()) {
+	 field->BlendToCurrent(magConf->GetCurrent());
+      } else if (magConf->IsBlended() && magConf->CentralFieldIsDefined()) {
+	 field->BlendToCentralField(magConf->GetCentralField());
+      }
+      if (!strcmp(magConf->GetFieldLayout(),"cell")) {
+	 field->SetLayout(art::TSamuraiMagnetField::kCellMajor);
+      }
+      if (magConf->IsPlanar()) {
+	 field->SetPlanar();
+      }
+      art::TSamuraiFieldTiles *const tiles = field->GetTiles();
+      if (tiles && magConf->GetTileCacheSize() > 0) {
+	 tiles->SetCapacity(magConf->GetTileCacheSize());
+      }
+      if (!strcmp(magConf->GetQuantization(),"half")) {
+	 field->SetQuantization(art::TSamuraiMagnetField::kHalf);
+      } else if (!strcmp(magConf->GetQuantization(),"int16")) {
+	 field->SetQuantization(art::TSamuraiMagnetField::kInt16);
+      }
+      if (*magConf->GetHugePages() || magConf->IsNumaReplicated()) {
+	 art::TSamuraiFieldArena::EPages pages = art::TSamuraiFieldArena::kSmallPages;
+	 if (!strcmp(magConf->GetHugePages(),"transparent")) {
+	    pages = art::TSamuraiFieldArena::kTransparentHuge;
+	 } else if (!strcmp(magConf->GetHugePages(),"explicit")) {
+	    pages = art::TSamuraiFieldArena::kExplicitHuge;
+	 }
+	 field->SetArena(pages,magConf->IsNumaReplicated());
+      }
+      if (!strcmp(magConf->GetInterpolation(),"cubic")) {
+	 field->SetInterpolation(art::TSamuraiMagnetField::kTricubic,
+				 magConf->GetCubicCacheSize() > 0
+				 ? magConf->GetCubicCacheSize() : 0);
+      }
+   }
+
+   // field of Model "enge" or "map+enge"
+   art::TMagneticField* MakeModelField(trace::TMagnetConfig *magConf,
+				       art::TSamuraiMagnetField::EStorage storage)
+   {
+      const bool withMap = !strcmp(magConf->GetModel(),"map+enge");
+      if (!withMap && strcmp(magConf->GetModel(),"enge")) {
+	 printf("Unknown field model: %s\n",magConf->GetModel());
+	 return NULL;
+      }
+
+      art::TEngeDipoleField *const enge =
+	 new art::TEngeDipoleField(magConf->GetEngeCentralField(),
+				   magConf->GetEngeRadius(),
+				   magConf->GetEngeGap());
+      if (!magConf->GetEngeCoefficients().empty()) {
+	 if (!enge->SetCoefficients(magConf->GetEngeCoefficients())) {
+	    delete enge;
+	    return NULL;
+	 }
+      } else if (withMap) {
+	 /* a model fitted to the map would count the map twice */
+	 printf("Model map+enge needs Enge Coefficients\n");
+	 delete enge;
+	 return NULL;
+      } else {
+	 /* the map is needed for the fit only */
+	 const art::TSamuraiMagnetField map(magConf->GetFieldFile(),
+					    magConf->GetFieldMap(),1.,storage);
+	 double rms = 0.;
+	 if (!enge->Fit(map,6,&rms)) {
+	    printf("Failed to fit the Enge model to %s\n",magConf->GetFieldFile());
+	    delete enge;
+	    return NULL;
+	 }
+	 printf("Enge model fitted to %s (rms %.2g T):\n",
+		magConf->GetFieldFile(),rms);
+	 enge->Print();
+      }
+      if (!withMap) return enge;
+
+      art::TSamuraiMagnetField *const map =
+	 new art::TSamuraiMagnetField(magConf->GetFieldFile(),
+				      magConf->GetFieldMap(),1.,storage);
+      if (map->IsGood()) SetupField(map,magConf);
+      art::TCompositeField *const sum = new art::TCompositeField;
+      sum->Add(map);
+      sum->Add(enge);
+      return sum;
+   }
+}
+
 int main(int argc, char* argv[])
 {
    using namespace trace;
@@ -21,15 +122,30 @@ int main(int argc, char* argv[])
       exit(errno);
    }
 
-   TGeometryConfig *const geoConf = TGeometryConfig::GetInstance();
-   geoConf->LoadFile(gconf->GetGeometryConfigFile());
-
    TMagnetConfig *const magConf = TMagnetConfig::GetInstance();
    magConf->LoadFile(gconf->GetMagnetConfigFile());
    if (!magConf->IsGood()) {
       return -3;
    }
 
+   /* start loading the field map; it overlaps with the setup below */
+   art::TSamuraiTracer *tracer = new art::TSamuraiTracer;
+   art::TSamuraiMagnetField::EStorage storage = art::TSamuraiMagnetField::kMmap;
+   if (!strcmp(magConf->GetFieldStorage(),"heap")) {
+      storage = art::TSamuraiMagnetField::kHeap;
+   } else if (!strcmp(magConf->GetFieldStorage(),"shared")) {
+      storage = art::TSamuraiMagnetField::kShared;
+   }
+   if (!strcmp(magConf->GetModel(),"map")) {
+      tracer->LoadFieldAsync(magConf->GetFieldFile(),magConf->GetFieldMap(),1.,
+			     storage,SetupField,magConf);
+   } else {
+      tracer->SetField(MakeModelField(magConf,storage));
+   }
+
+   TGeometryConfig *const geoConf = TGeometryConfig::GetInstance();
+   geoConf->LoadFile(gconf->GetGeometryConfigFile());
+
    SetLegendXOffset(gconf->GetLegendXOffset());
    SetLegendYOffset(gconf->GetLegendYOffset());
    SetLegendSpacing(gconf->GetLegendSpacing());
@@ -45,30 +161,34 @@ int main(int argc, char* argv[])
    AddMagnet(&drawees,&bounds);
    AddExitObjects(&drawees,&bounds);
 
-   /* trajectory */
-   art::TSamuraiTracer *tracer = new art::TSamuraiTracer;
-   tracer->LoadField(magConf->GetFieldFile());
-   if (!tracer->IsGood()) {
-      return -4;
-   }
-
-   if(magConf->CentralFieldIsDefined()) {
-      tracer->ScaleCentralFieldTo(magConf->GetCentralField());
-   }
    tracer->SetMaxPoint(gconf->GetTrajectoryMaxPoint());
    tracer->SetStepLength(gconf->GetTrajectoryStepLength());
+   if (!strcmp(gconf->GetTrajectoryPrecision(),"float")) {
+      tracer->SetPrecision(art::TSamuraiTracer::kSingle);
+   }
+   if (!strcmp(gconf->GetTrajectoryIntegrator(),"adaptive")) {
+      tracer->SetIntegrator(art::TSamuraiTracer::kDormandPrince);
+      tracer->SetTolerance(gconf->GetTrajectoryPositionTolerance(),
+			   gconf->GetTrajectoryAngleTolerance());
+      tracer->SetMaxStepLength(gconf->GetTrajectoryMaxStepLength());
+   }
+   tracer->SetDriftMargin(gconf->GetTrajectoryDriftMargin());
    tracer->SetRotationAngle(geoConf->GetMagnetAngle());
 
-   tracer->SetEndPlaneAngle(-60.);
-   tracer->SetEndPlaneDistance(6750);
-
-   {
-      const TString &b = TString::Format("#it{B}_{#it{z}}(0,0,0) = %.2f T",
-					 tracer->GetCentralField());
-      AddLegend(&drawees, gconf, b.Data());
+   tracer->SetEndPlaneAngle(gconf->GetEndPlaneAngle());
+   tracer->SetEndPlaneDistance(gconf->GetEndPlaneDistance());
+   if (gconf->GetMaxFlightLength() > 0.) {
+      tracer->AddMaxLength(gconf->GetMaxFlightLength(),"max flight length");
+   }
+   if (gconf->GetMaxBendAngle() > 0.) {
+      tracer->AddMaxBend(gconf->GetMaxBendAngle(),"max bend angle");
    }
 
-   AddDetectors(&drawees,gconf);
+   /* the central field legend is filled in once the field is loaded */
+   const float centralFieldLegendY = GetLegendYOffset();
+   ForwardLegend();
+
+   AddDetectors(&drawees,gconf,gconf->GetRecordDetectors() ? tracer : NULL);
 
    ForwardLegend();
 
@@ -78,11 +198,67 @@ int main(int argc, char* argv[])
       return -1;
    }
 
+   /* trajectory */
+   if (!tracer->IsGood()) {
+      return -4;
+   }
+   if (magConf->IsNumaReplicated()) {
+      /* keep the tracing thread next to its replica */
+      art::TSamuraiFieldArena::BindThread(art::TSamuraiFieldArena::GetThreadNode());
+   }
+   art::TSamuraiMagnetField *const map = tracer->GetField(); // NULL for models
+   art::TSamuraiFieldTiles *const tiles = map ? map->GetTiles() : NULL;
+
+   if(magConf->CentralFieldIsDefined()) {
+      tracer->ScaleCentralFieldTo(magConf->GetCentralField());
+   }
+   if (gconf->GetPreviewLevel()) {
+      tracer->SetPreviewLevel(gconf->GetPreviewLevel());
+   }
+
+   {
+      const float legendY = GetLegendYOffset();
+      SetLegendYOffset(centralFieldLegendY);
+      const TString &b = TString::Format("#it{B}_{#it{z}}(0,0,0) = %.2f T",
+					 tracer->GetCentralField());
+      AddLegend(&drawees, gconf, b.Data());
+      SetLegendYOffset(legendY);
+   }
+
+   art::TSamuraiTracer::Statistics steps = art::TSamuraiTracer::Statistics();
    for(SettingVec_t::const_iterator it = settings.begin();
        it != settings.end(); ++it) {
       const int n = it - settings.begin();
       AddTrajectory(tracer,*it,&drawees,&bounds,gconf,n);
+      const art::TSamuraiTracer::Statistics &stats = tracer->GetStatistics();
+      steps.fAccepted += stats.fAccepted;
+      steps.fRejected += stats.fRejected;
+      steps.fEvals += stats.fEvals;
+      steps.fDrift += stats.fDrift;
+   }
+   printf("tracing: %lu steps, %lu rejected, %lu drifted, %lu field lookups\n",
+	  steps.fAccepted,steps.fRejected,steps.fDrift,steps.fEvals);
+
+   tracer->GetCursor().Print();
+   if (tiles) {
+      printf("field tiles: %lu hits, %lu misses, %lu kB resident\n",
+	     tiles->GetHits(),tiles->GetMisses(),
+	     (unsigned long)(tiles->GetResidentBytes() >> 10));
+   }
+   if (const art::TSamuraiFieldCubic *const cubic = map ? map->GetCubic() : NULL) {
+      printf("tricubic cells: %lu hits, %lu misses, %lu kB resident\n",
+	     cubic->GetHits(),cubic->GetMisses(),
+	     (unsigned long)(cubic->GetResidentBytes() >> 10));
+   }
+#ifdef SAMURAI_FIELD_STATS
+   if (const art::TSamuraiFieldStats *const stats = map ? map->GetStats() : NULL) {
+      stats->Print();
+      const std::string heatmap = std::string(gconf->GetOutFile()) + ".heatmap";
+      if (stats->WriteHeatmap(heatmap.c_str())) {
+	 printf("field heatmap: %s\n",heatmap.c_str());
+      }
    }
+#endif
 
    TCanvas *const canvas = new TCanvas("canvas","canvas",
 				       gconf->GetCanvasW(),gconf->GetCanvasH());
@@ -201,7 +201,7 @@ const TGeneralConfig* InitConfig(int argc, char *argv[], int *errno)
    TGeneralConfig* conf = new TGeneralConfig();
    { /* analyze options */
       char opt;
-      while((opt = getopt(argc,argv,"fg:hm:o:")) != -1){
+      while((opt = getopt(argc,argv,"fg:hm:o:p:")) != -1){
 	 switch (opt) {
 	    case 'f':
 	       conf->SetOverwrite();
@@ -215,6 +215,9 @@ const TGeneralConfig* InitConfig(int argc, char *argv[], int *errno)
 	    case 'm':
 	       conf->SetMagnetConfigFile(optarg);
 	       break;
+	    case 'p':
+	       conf->SetPreviewLevel(atoi(optarg));
+	       break;
 	    case 'h':
 	       Usage();
 	       exit(0);
@@ -271,7 +274,7 @@ void SetStyles()
 
 void Usage()
 {
-   printf("usage: trace [-h] [-o <output>] [-g <geometry_config>] [-m <magnet_config>] <input>\n");
+   printf("usage: trace [-h] [-o <output>] [-g <geometry_config>] [-m <magnet_config>] [-p <preview level>] <input>\n");
 }
 
 void AddTrajectory(art::TSamuraiTracer *tracer, const trace_setting &setting,
@@ -306,6 +309,23 @@ void AddTrajectory(art::TSamuraiTracer *tracer, const trace_setting &setting,
    const double flightlength =
       (NPOINTS == n_last) ? tracer->GetFlightLength() : 0./0.;
    printf("fl[%d] = %.1f mm\n",n,flightlength);
+   /* the tracer does not know the yoke: a track cut at the bounds or
+      the viewport has no valid crossings beyond */
+   if (NPOINTS == n_last) {
+      const std::vector<art::TSamuraiTracer::Crossing> &crossings =
+	 tracer->GetCrossings();
+      for (size_t i = 0; i != crossings.size(); ++i) {
+	 const art::TSamuraiTracer::Crossing &c = crossings[i];
+	 printf("   %s: (%.1f, %.1f) mm, fl = %.1f mm\n",
+		tracer->GetConditionName(c.fCondition),
+		c.fPosition[0],c.fPosition[1],c.fLength);
+      }
+      const int stop = tracer->GetStopCondition();
+      if (stop != art::TSamuraiTracer::kEndPlane
+	  && stop != art::TSamuraiTracer::kNoCondition) {
+	 printf("   stopped at %s\n",tracer->GetConditionName(stop));
+      }
+   }
 
    drawees->Add(MakePolyLine(n_last,&x[0],&y[0],conf->GetTrajAttLine(setting.color)));
    AddLegend(drawees,conf,setting.comment.c_str(),setting.color);